@@ -0,0 +1,68 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#include "receive_pipeline.hpp"
+
+#include <cstdlib>
+#include <string>
+
+#include "../src/event.cpp"
+#include "../src/irc.cpp"
+#include "../src/network.cpp"
+#include "../src/modules/connection.cpp"
+#include "../src/modules/event_manager.cpp"
+#include "../src/util/line_scanner.cpp"
+
+// Measures the whole receive pipeline, from the socket through the
+// connection and the event manager to a handler, against a local IRC server
+// stand-in:
+// - the lines per second reaching a handler while the stand-in blasts
+//   PRIVMSG floods, netjoins and NAMES replies, and
+// - the round trip of a handler replying to a message, as seen by the
+//   stand-in.
+//
+// Usage: bench.connection.end_to_end [lines per pattern] [round trips]
+
+namespace {
+	bool throughput(const std::string &name, const std::string &pattern, unsigned long long lines) {
+		slirc::test::irc_server server;
+		return slirc::bench::throughput(name, server, "irc://127.0.0.1:" + std::to_string(server.port()), pattern, lines);
+	}
+
+	bool round_trips(unsigned long long count) {
+		slirc::test::irc_server server;
+		return slirc::bench::round_trips("end_to_end: handler reply round trip",
+			server, "irc://127.0.0.1:" + std::to_string(server.port()), count);
+	}
+}
+
+int main(int argc, char **argv) {
+	const auto lines = slirc::bench::iterations(argc, argv, 1000000);
+	const unsigned long long trips = (argc > 2) ? std::strtoull(argv[2], nullptr, 10) : 10000;
+
+	const bool ok =
+		throughput("end_to_end: PRIVMSG flood (lines)", slirc::test::irc_server::privmsg_flood("#bench", 100), lines)
+		&& throughput("end_to_end: netjoin (lines)", slirc::test::irc_server::netjoin("#bench", 100), lines)
+		&& throughput("end_to_end: NAMES of 5000 users (lines)", slirc::test::irc_server::names("bench", "#bench", 5000), lines)
+		&& round_trips(trips);
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#include "benchmark.hpp"
+
+#include <functional>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include "../include/slirc/irc.hpp"
+#include "../include/slirc/network.hpp"
+#include "../include/slirc/apis/event_manager.hpp"
+#include "../include/slirc/modules/connection.hpp"
+
+#include "../src/event.cpp"
+#include "../src/irc.cpp"
+#include "../src/network.cpp"
+#include "../src/modules/connection.cpp"
+#include "../src/modules/event_manager.cpp"
+#include "../src/util/line_scanner.cpp"
+
+// Measures the time to connect to a host name resolving to several
+// addresses when the first one is black-holed: a listener stand-in on that
+// address has a full accept queue and never accepts, so connection
+// attempts to it hang. The other address has a listener that accepts.
+//
+// Usage: bench.connection.happy_eyeballs [rounds] [host name]
+// The host name (default: localhost) should resolve to both ::1 and
+// 127.0.0.1; otherwise only plain connects are measured.
+
+namespace asio = boost::asio;
+
+int main(int argc, char **argv) {
+	const auto rounds = slirc::bench::iterations(argc, argv, 5);
+	const std::string host = (argc > 2) ? argv[2] : "localhost";
+
+	asio::io_service &service = slirc::network::service();
+
+	// find out which address the connection will try first
+	asio::ip::tcp::resolver resolver(service);
+	std::vector<asio::ip::tcp::endpoint> resolved;
+	for(auto it = resolver.resolve(asio::ip::tcp::resolver::query(host, "0"));
+		it != asio::ip::tcp::resolver::iterator(); ++it
+	) {
+		resolved.push_back(*it);
+	}
+	const auto first_address = resolved.front().address();
+	optional<asio::ip::address> second_address;
+	for(const auto &endpoint : resolved) {
+		if (endpoint.protocol() != resolved.front().protocol()) {
+			second_address = endpoint.address();
+			break;
+		}
+	}
+
+	// the live listener; with two address families, the first one is black-holed
+	asio::ip::tcp::acceptor live(service,
+		asio::ip::tcp::endpoint(second_address ? *second_address : first_address, 0));
+	const unsigned short port = live.local_endpoint().port();
+
+	optional<asio::ip::tcp::acceptor> black_hole;
+	std::vector<std::unique_ptr<asio::ip::tcp::socket>> backlog;
+	if (second_address) {
+		black_hole.emplace(service, asio::ip::tcp::endpoint(first_address, port), false);
+		black_hole->listen(0);
+		for(int i=0; i<8; ++i) {
+			backlog.emplace_back(new asio::ip::tcp::socket(service));
+			backlog.back()->async_connect(black_hole->local_endpoint(), [](const boost::system::error_code &){});
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+	}
+
+	std::cout
+		<< "host:           " << host << " (" << resolved.size() << " addresses)\n"
+		<< "black-holed:    " << (second_address ? first_address.to_string() : std::string("none")) << "\n"
+		<< "listening:      " << live.local_endpoint() << "\n";
+
+	std::vector<std::unique_ptr<asio::ip::tcp::socket>> accepted;
+	std::function<void()> accept_next = [&] {
+		accepted.emplace_back(new asio::ip::tcp::socket(service));
+		live.async_accept(*accepted.back(), [&](const boost::system::error_code &error) {
+			if (!error) accept_next();
+		});
+	};
+	accept_next();
+
+	slirc::bench::stopwatch total;
+	for(unsigned long long i=0; i<rounds; ++i) {
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+
+		bool connected = false;
+		irc.event_manager().connect(slirc::apis::connection::state::connected, [&](slirc::event::pointer) {
+			connected = true;
+		});
+
+		slirc::bench::stopwatch timer;
+		connection.connect(host, port);
+		while(!connected) {
+			if (auto e = irc.event_manager().wait_event(std::chrono::seconds(30))) {
+				e->handle();
+			}
+			else {
+				std::cout << "round " << i << ": no connection after 30 s\n";
+				return 1;
+			}
+		}
+		std::cout << "round " << i << ": connected in "
+			<< std::fixed << std::setprecision(1) << timer.seconds() * 1000 << " ms\n";
+		connection.disconnect();
+	}
+	slirc::bench::report("connect with first address black-holed", rounds, total.seconds());
+
+	// the listeners are used by the service thread; tear them down there
+	std::promise<void> closed;
+	service.post([&]{
+		live.close();
+		if (black_hole) black_hole->close();
+		backlog.clear();
+		accepted.clear();
+		closed.set_value();
+	});
+	closed.get_future().wait();
+}
@@ -0,0 +1,111 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#include "benchmark.hpp"
+#include "../test/irc_server.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+#include "../include/slirc/irc.hpp"
+#include "../include/slirc/transport.hpp"
+#include "../include/slirc/apis/event_manager.hpp"
+#include "../include/slirc/modules/connection.hpp"
+
+#include "../src/event.cpp"
+#include "../src/irc.cpp"
+#include "../src/network.cpp"
+#include "../src/modules/connection.cpp"
+#include "../src/modules/event_manager.cpp"
+#include "../src/util/line_scanner.cpp"
+
+// Measures the receive path of the connection in isolation: the data is
+// fed through a memory pipe rather than read from a socket, so the lines
+// per second are limited by buffering, line splitting and the event
+// manager alone. Compare with bench.connection.end_to_end for the cost of
+// the socket.
+//
+// Usage: bench.connection.memory_pipe [lines per pattern]
+
+namespace {
+	bool run(const std::string &name, const std::string &block, unsigned long long lines,
+		slirc::modules::connection::line_delivery delivery
+	) {
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+		connection.set_line_delivery(delivery);
+
+		unsigned long long handled = 0;
+		bool disconnected = false;
+		irc.event_manager().connect(slirc::apis::connection::received_line, [&](slirc::event::pointer){ ++handled; });
+		irc.event_manager().connect(slirc::apis::connection::received_lines, [&](slirc::event::pointer e){
+			handled += e->components.at<slirc::apis::connection::received_line_batch>().size();
+		});
+		irc.event_manager().connect(slirc::apis::connection::state::disconnected, [&](slirc::event::pointer){ disconnected = true; });
+
+		auto pipe = std::make_shared<slirc::network::memory_pipe>();
+		connection.connect(pipe);
+
+		const unsigned long long block_lines = std::count(block.begin(), block.end(), '\n');
+		const unsigned long long repeats = std::max(1ULL, lines / block_lines);
+		slirc::bench::stopwatch timer;
+		for(unsigned long long i=0; i<repeats; ++i) {
+			pipe->feed(block);
+
+			// keep the event queue short
+			while(auto e = irc.event_manager().wait_event(std::chrono::milliseconds(0))) {
+				e->handle();
+			}
+		}
+		const bool complete = slirc::bench::handle_events_until(irc, [&]{ return handled == repeats * block_lines; });
+		const double seconds = timer.seconds();
+
+		pipe->end();
+		if (!complete || !slirc::bench::handle_events_until(irc, [&]{ return disconnected; })) {
+			std::cout << name << ": stalled\n";
+			return false;
+		}
+		slirc::bench::report(name, handled, seconds);
+		return true;
+	}
+}
+
+int main(int argc, char **argv) {
+	typedef slirc::modules::connection::line_delivery line_delivery;
+	typedef slirc::test::irc_server irc_server;
+	const auto lines = slirc::bench::iterations(argc, argv, 1000000);
+
+	const std::string flood = irc_server::privmsg_flood("#bench", 100);
+	const std::string netjoin = irc_server::netjoin("#bench", 100);
+	const std::string names = irc_server::names("bench", "#bench", 5000);
+
+	bool ok = true;
+	for(const auto delivery : { line_delivery::lines, line_delivery::batches }) {
+		const std::string suffix = delivery == line_delivery::lines ? ", line events (lines)" : ", batch events (lines)";
+		ok = ok
+			&& run("memory_pipe: PRIVMSG flood" + suffix, flood, lines, delivery)
+			&& run("memory_pipe: netjoin" + suffix, netjoin, lines, delivery)
+			&& run("memory_pipe: NAMES of 5000 users" + suffix, names, lines, delivery);
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,115 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#include "benchmark.hpp"
+#include "../test/irc_server.hpp"
+
+#include <cstdio>
+#include <string>
+
+#include "../include/slirc/irc.hpp"
+#include "../include/slirc/apis/event_manager.hpp"
+#include "../include/slirc/modules/connection.hpp"
+
+#include "../src/event.cpp"
+#include "../src/irc.cpp"
+#include "../src/network.cpp"
+#include "../src/modules/connection.cpp"
+#include "../src/modules/event_manager.cpp"
+#include "../src/util/line_scanner.cpp"
+
+// Replays a capture of received traffic as fast as possible, from the
+// memory mapped file through line splitting and the event manager to a
+// handler. Without a capture file, one of a PRIVMSG flood from a local IRC
+// server stand-in is recorded first.
+//
+// Usage: bench.connection.replay [lines] [capture file]
+
+namespace {
+	bool record(const std::string &path, unsigned long long lines) {
+		slirc::test::irc_server server;
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+		connection.set_registration("NICK bench\r\nUSER bench 0 * :Benchmark\r\n");
+
+		unsigned long long handled = 0;
+		irc.event_manager().connect(slirc::apis::connection::received_line, [&](slirc::event::pointer){ ++handled; });
+
+		connection.start_capture(path);
+		connection.connect("irc://127.0.0.1", server.port());
+		if (!server.wait_for_registrations(1)) {
+			return false;
+		}
+		const unsigned long long repeats = std::max(1ULL, lines / 100);
+		server.blast(slirc::test::irc_server::privmsg_flood("#bench", 100), repeats);
+		const bool complete = slirc::bench::handle_events_until(irc, [&]{ return handled == 1 + repeats * 100; });
+		connection.disconnect();
+		connection.stop_capture();
+		return complete;
+	}
+
+	bool replay(const std::string &path, slirc::modules::connection::line_delivery delivery, const std::string &name) {
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+		connection.set_line_delivery(delivery);
+
+		unsigned long long handled = 0;
+		bool done = false;
+		irc.event_manager().connect(slirc::apis::connection::received_line, [&](slirc::event::pointer){ ++handled; });
+		irc.event_manager().connect(slirc::apis::connection::received_lines, [&](slirc::event::pointer e){
+			handled += e->components.at<slirc::apis::connection::received_line_batch>().size();
+		});
+		irc.event_manager().connect(slirc::apis::connection::state::disconnected, [&](slirc::event::pointer){ done = true; });
+
+		slirc::bench::stopwatch timer;
+		connection.replay(path);
+		if (!slirc::bench::handle_events_until(irc, [&]{ return done; })) {
+			std::cout << name << ": stalled\n";
+			return false;
+		}
+		const double seconds = timer.seconds();
+		slirc::bench::report(name, handled, seconds);
+		std::cout << "  " << std::fixed << std::setprecision(1)
+			<< connection.get_traffic_stats().bytes_in / seconds / (1024*1024) << " MiB/s\n";
+		return true;
+	}
+}
+
+int main(int argc, char **argv) {
+	const auto lines = slirc::bench::iterations(argc, argv, 1000000);
+	const bool recorded = argc <= 2;
+	const std::string path = recorded ? "bench.connection.replay.capture" : argv[2];
+
+	if (recorded && !record(path, lines)) {
+		std::cout << "recording the capture failed\n";
+		return 1;
+	}
+
+	const bool ok =
+		replay(path, slirc::modules::connection::line_delivery::lines, "replay: line events (lines)")
+		&& replay(path, slirc::modules::connection::line_delivery::batches, "replay: batch events (lines)");
+
+	if (recorded) {
+		std::remove(path.c_str());
+	}
+	return ok ? 0 : 1;
+}
@@ -0,0 +1,145 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#include "benchmark.hpp"
+#include "tls_server.hpp"
+
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <openssl/x509.h>
+
+#include "../include/slirc/irc.hpp"
+#include "../include/slirc/apis/event_manager.hpp"
+#include "../include/slirc/modules/connection.hpp"
+
+#include "../src/event.cpp"
+#include "../src/irc.cpp"
+#include "../src/network.cpp"
+#include "../src/modules/connection.cpp"
+#include "../src/modules/event_manager.cpp"
+#include "../src/util/line_scanner.cpp"
+
+// Compares the memory used by many TLS connections to a local TLS server
+// stand-in when they share one TLS context with giving each connection a
+// context of its own, as was done before. Every context loads the system's
+// default trust store.
+//
+// Usage: bench.connection.tls_context [connections] [shared|separate]
+// Without a mode, both are measured, each in a process of its own.
+
+namespace asio = boost::asio;
+
+namespace {
+	std::size_t resident_bytes() {
+		std::size_t pages = 0, resident = 0;
+		std::ifstream("/proc/self/statm") >> pages >> resident;
+		return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	}
+
+	std::shared_ptr<asio::ssl::context> make_context() {
+		auto context = std::make_shared<asio::ssl::context>(asio::ssl::context::sslv23_client);
+		boost::system::error_code ec;
+		context->load_verify_file(X509_get_default_cert_file(), ec);
+		if (ec) {
+			context->set_default_verify_paths(ec);
+		}
+		return context;
+	}
+
+	int measure(unsigned long long connections, bool shared) {
+		slirc::bench::tls_server server;
+
+		const std::size_t before = resident_bytes();
+		slirc::bench::stopwatch timer;
+
+		std::shared_ptr<asio::ssl::context> common;
+		if (shared) {
+			common = make_context();
+		}
+
+		std::vector<std::unique_ptr<slirc::irc>> ircs;
+		unsigned long long greeted = 0;
+		for(unsigned long long i=0; i<connections; ++i) {
+			ircs.emplace_back(new slirc::irc);
+			auto &connection = ircs.back()->load<slirc::modules::connection>();
+			connection.set_tls_context(shared ? common : make_context());
+			ircs.back()->event_manager().connect(slirc::apis::connection::received_line,
+				[&](slirc::event::pointer) { ++greeted; });
+			connection.connect("ssl://127.0.0.1", server.port());
+		}
+
+		while(greeted < connections) {
+			if (timer.seconds() > 120) {
+				std::cout << "only " << greeted << " of " << connections << " connections established\n";
+				return 1;
+			}
+			for(const auto &irc : ircs) {
+				while(auto e = irc->event_manager().wait_event(std::chrono::milliseconds(0))) {
+					e->handle();
+				}
+			}
+		}
+		const double seconds = timer.seconds();
+		const std::size_t after = resident_bytes();
+
+		const double mib = (after - before) / (1024.0 * 1024.0);
+		std::cout << std::fixed << std::setprecision(1)
+			<< (shared ? "shared context:    " : "separate contexts: ")
+			<< connections << " connections, " << mib << " MiB ("
+			<< (after - before) / 1024.0 / connections << " KiB per connection), "
+			<< "established in " << seconds * 1000 << " ms\n";
+		std::cout.flush();
+
+		// connections and stand-in share nothing; do not bother tearing down
+		std::_Exit(0);
+	}
+}
+
+int main(int argc, char **argv) {
+	const auto connections = slirc::bench::iterations(argc, argv, 1000);
+	const std::string mode = (argc > 2) ? argv[2] : "";
+
+	if (mode == "shared" || mode == "separate") {
+		return measure(connections, mode == "shared");
+	}
+
+	// run each mode in a fresh process, so that memory freed by one run
+	// cannot be reused by the other
+	int result = 0;
+	for(bool shared : { false, true }) {
+		const pid_t child = fork();
+		if (child == 0) {
+			return measure(connections, shared);
+		}
+		int status = 0;
+		waitpid(child, &status, 0);
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			result = 1;
+		}
+	}
+	return result;
+}
@@ -0,0 +1,157 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#include "benchmark.hpp"
+#include "tls_server.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../include/slirc/irc.hpp"
+#include "../include/slirc/network.hpp"
+#include "../include/slirc/apis/event_manager.hpp"
+#include "../include/slirc/modules/connection.hpp"
+
+#include "../src/event.cpp"
+#include "../src/irc.cpp"
+#include "../src/network.cpp"
+#include "../src/modules/connection.cpp"
+#include "../src/modules/event_manager.cpp"
+#include "../src/util/line_scanner.cpp"
+
+// Simulates a mass reconnect: many connections do their TLS handshakes with
+// a local TLS server stand-in at once, while an established connection keeps
+// sending PINGs to another stand-in that echoes them. Reports the round trip
+// times of the PINGs while idle and during the reconnect, with handshakes on
+// the network thread and on a handshake pool.
+//
+// Usage: bench.connection.tls_handshake_pool [connections] [pool threads]
+
+namespace {
+	typedef std::chrono::steady_clock clock;
+
+	bool wait_until_connected(slirc::modules::connection &connection) {
+		const auto deadline = clock::now() + std::chrono::seconds(10);
+		while(connection.current_state() != slirc::apis::connection::state::connected) {
+			if (deadline < clock::now()) {
+				return false;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		return true;
+	}
+
+	int run(unsigned long long connections, unsigned pool_threads) {
+		slirc::network::set_handshake_threads(pool_threads);
+
+		// a fresh stand-in per run, so no sessions can be resumed
+		slirc::bench::tls_server echo_server(true);
+		slirc::bench::tls_server storm_server;
+
+		slirc::irc pinger;
+		auto &ping_connection = pinger.load<slirc::modules::connection>();
+		ping_connection.connect("ssl://127.0.0.1", echo_server.port());
+		if (!wait_until_connected(ping_connection)) {
+			std::cout << "the PING connection was not established\n";
+			return 1;
+		}
+
+		// sends one PING at a time and waits for its echo
+		std::atomic<bool> storming(false), stop(false);
+		std::vector<double> idle, storm;
+		std::thread ping_thread([&] {
+			while(!stop) {
+				const bool during_storm = storming;
+				const auto sent = clock::now();
+				ping_connection.send_raw("PING :" + std::to_string(sent.time_since_epoch().count()) + "\r\n");
+				for(;;) {
+					auto e = pinger.event_manager().wait_event(std::chrono::milliseconds(1000));
+					if (!e) break; // lost; should not happen
+					if (e->components.has<slirc::apis::connection::received_data>()) {
+						const auto &line = e->components.at<slirc::apis::connection::received_data>().data();
+						if (line.compare(0, 6, "PING :") == 0
+							&& std::strtoll(line.c_str() + 6, nullptr, 10) == sent.time_since_epoch().count()
+						) {
+							const double ms = std::chrono::duration<double, std::milli>(clock::now() - sent).count();
+							(during_storm ? storm : idle).push_back(ms);
+							break;
+						}
+					}
+					e->handle();
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+			}
+		});
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+		std::vector<std::unique_ptr<slirc::irc>> ircs;
+		std::vector<slirc::modules::connection *> storm_connections;
+		slirc::bench::stopwatch timer;
+		storming = true;
+		for(unsigned long long i=0; i<connections; ++i) {
+			ircs.emplace_back(new slirc::irc);
+			storm_connections.push_back(&ircs.back()->load<slirc::modules::connection>());
+			storm_connections.back()->connect("ssl://127.0.0.1", storm_server.port());
+		}
+		for(auto connection : storm_connections) {
+			if (!wait_until_connected(*connection)) {
+				std::cout << "a reconnecting connection was not established\n";
+				stop = true;
+				ping_thread.join();
+				return 1;
+			}
+		}
+		storming = false;
+		const double seconds = timer.seconds();
+		stop = true;
+		ping_thread.join();
+
+		std::cout
+			<< "handshake threads: " << pool_threads << "\n"
+			<< "  reconnected:     " << connections << " connections in "
+				<< std::fixed << std::setprecision(1) << seconds * 1000 << " ms\n"
+			<< "  PING while idle: " << slirc::bench::percentiles(idle) << "\n"
+			<< "  PING meanwhile:  " << slirc::bench::percentiles(storm) << "\n";
+
+		for(auto connection : storm_connections) {
+			connection->disconnect();
+		}
+		ping_connection.disconnect();
+		return 0;
+	}
+}
+
+int main(int argc, char **argv) {
+	const auto connections = slirc::bench::iterations(argc, argv, 300);
+	const unsigned pool_threads = (argc > 2) ? std::atoi(argv[2]) : 2;
+
+	int result = run(connections, 0);
+	if (!result) {
+		result = run(connections, pool_threads);
+	}
+	slirc::network::set_handshake_threads(0);
+	return result;
+}
@@ -0,0 +1,110 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#include "benchmark.hpp"
+#include "tls_server.hpp"
+
+#include <chrono>
+
+#include "../include/slirc/irc.hpp"
+#include "../include/slirc/apis/event_manager.hpp"
+#include "../include/slirc/modules/connection.hpp"
+
+#include "../src/event.cpp"
+#include "../src/irc.cpp"
+#include "../src/network.cpp"
+#include "../src/modules/connection.cpp"
+#include "../src/modules/event_manager.cpp"
+#include "../src/util/line_scanner.cpp"
+
+// Connects to a local TLS server stand-in over and over and compares the
+// time of the first (full) handshake with the later ones, which should
+// resume the session of the previous connection.
+//
+// Usage: bench.connection.tls_resumption [rounds]
+// Fails if none of the reconnects resumed a session.
+
+int main(int argc, char **argv) {
+	typedef std::chrono::duration<double, std::milli> milliseconds;
+
+	const auto rounds = slirc::bench::iterations(argc, argv, 20);
+	slirc::bench::tls_server server;
+
+	slirc::irc irc;
+	auto &connection = irc.load<slirc::modules::connection>();
+
+	bool greeted = false;
+	bool disconnected = false;
+	irc.event_manager().connect(slirc::apis::connection::received_line, [&](slirc::event::pointer) {
+		// by now session tickets sent after the handshake have been read
+		greeted = true;
+	});
+	irc.event_manager().connect(slirc::apis::connection::state::disconnected, [&](slirc::event::pointer) {
+		disconnected = true;
+	});
+	auto wait_for = [&](const bool &flag) {
+		while(!flag) {
+			if (auto e = irc.event_manager().wait_event(std::chrono::seconds(10))) {
+				e->handle();
+			}
+			else {
+				return false;
+			}
+		}
+		return true;
+	};
+
+	milliseconds full(0), resumed(0);
+	unsigned long long full_count = 0, resumed_count = 0;
+
+	slirc::bench::stopwatch total;
+	for(unsigned long long i=0; i<rounds; ++i) {
+		greeted = disconnected = false;
+		connection.connect("ssl://127.0.0.1", server.port());
+		if (!wait_for(greeted)) {
+			std::cout << "round " << i << ": no greeting after 10 s\n";
+			return 1;
+		}
+
+		const auto stats = connection.get_statistics();
+		const milliseconds handshake = stats.last_handshake_time;
+		(stats.last_handshake_resumed ? resumed : full) += handshake;
+		++(stats.last_handshake_resumed ? resumed_count : full_count);
+		std::cout << "round " << i << ": "
+			<< (stats.last_handshake_resumed ? "resumed" : "full   ") << " handshake in "
+			<< std::fixed << std::setprecision(3) << handshake.count() << " ms\n";
+
+		connection.disconnect();
+		wait_for(disconnected);
+	}
+	slirc::bench::report("connect + handshake + greeting", rounds, total.seconds());
+
+	std::cout << std::fixed << std::setprecision(3)
+		<< "full handshakes:    " << full_count << ", average "
+		<< (full_count ? full.count() / full_count : 0) << " ms\n"
+		<< "resumed handshakes: " << resumed_count << ", average "
+		<< (resumed_count ? resumed.count() / resumed_count : 0) << " ms\n"
+		<< "server saw:         " << server.handshakes << " handshakes, "
+		<< server.resumed << " resumed\n";
+
+	return (rounds < 2 || resumed_count > 0) ? 0 : 1;
+}
@@ -0,0 +1,82 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#include "receive_pipeline.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+
+#include "../src/event.cpp"
+#include "../src/irc.cpp"
+#include "../src/network.cpp"
+#include "../src/modules/connection.cpp"
+#include "../src/modules/event_manager.cpp"
+#include "../src/util/line_scanner.cpp"
+
+// Compares loopback TCP with a Unix domain socket, as used to reach a
+// bouncer on the same host, against a local IRC server stand-in listening
+// on both:
+// - the lines per second of a PRIVMSG flood reaching a handler, and
+// - the round trip of a handler replying to a message.
+//
+// Usage: bench.connection.unix_socket [lines] [round trips]
+
+namespace {
+	const std::string socket_path = "bench.connection.unix_socket.sock";
+
+	std::string endpoint_of(const std::string &transport, const slirc::test::irc_server &server) {
+		return transport == "tcp"
+			? "irc://127.0.0.1:" + std::to_string(server.port())
+			: "unix://" + socket_path;
+	}
+
+	bool throughput(const std::string &transport, unsigned long long lines,
+		slirc::modules::connection::line_delivery delivery
+	) {
+		const std::string name = "unix_socket: " + transport + ", PRIVMSG flood, "
+			+ (delivery == slirc::modules::connection::line_delivery::lines ? "line" : "batch") + " events (lines)";
+		slirc::test::irc_server server("stand-in", socket_path);
+		return slirc::bench::throughput(name, server, endpoint_of(transport, server),
+			slirc::test::irc_server::privmsg_flood("#bench", 100), lines, delivery);
+	}
+
+	bool round_trips(const std::string &transport, unsigned long long count) {
+		slirc::test::irc_server server("stand-in", socket_path);
+		return slirc::bench::round_trips("unix_socket: " + transport + ", reply round trip",
+			server, endpoint_of(transport, server), count);
+	}
+}
+
+int main(int argc, char **argv) {
+	const auto lines = slirc::bench::iterations(argc, argv, 1000000);
+	const unsigned long long trips = std::max(1ULL, (argc > 2) ? std::strtoull(argv[2], nullptr, 10) : 10000);
+
+	bool ok = true;
+	for(const std::string transport : { "tcp", "unix" }) {
+		ok = ok
+			&& throughput(transport, lines, slirc::modules::connection::line_delivery::lines)
+			&& throughput(transport, lines, slirc::modules::connection::line_delivery::batches)
+			&& round_trips(transport, trips);
+	}
+	return ok ? 0 : 1;
+}
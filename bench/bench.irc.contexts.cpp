@@ -0,0 +1,71 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#include "benchmark.hpp"
+
+#include <memory>
+#include <vector>
+
+#include "../include/slirc/irc.hpp"
+
+#include "../src/event.cpp"
+#include "../src/irc.cpp"
+#include "../src/modules/event_manager.cpp"
+
+// Creates and tears down many irc contexts, once as full contexts with their
+// own event manager and once as lightweight contexts sharing one.
+
+int main(int argc, char **argv) {
+	const auto count = slirc::bench::iterations(argc, argv, 50000);
+
+	std::cout
+		<< "sizeof(slirc::irc) = " << sizeof(slirc::irc) << " bytes\n";
+
+	{ std::vector<std::unique_ptr<slirc::irc>> contexts;
+		contexts.reserve(count);
+
+		slirc::bench::stopwatch create;
+		for(unsigned long long i=0; i<count; ++i) {
+			contexts.emplace_back(new slirc::irc);
+		}
+		slirc::bench::report("create full contexts", count, create.seconds());
+
+		slirc::bench::stopwatch destroy;
+		contexts.clear();
+		slirc::bench::report("destroy full contexts", count, destroy.seconds());
+	}
+
+	{ slirc::irc host;
+		std::vector<std::unique_ptr<slirc::irc>> contexts;
+		contexts.reserve(count);
+
+		slirc::bench::stopwatch create;
+		for(unsigned long long i=0; i<count; ++i) {
+			contexts.emplace_back(new slirc::irc(host.event_manager()));
+		}
+		slirc::bench::report("create lightweight contexts", count, create.seconds());
+
+		slirc::bench::stopwatch destroy;
+		contexts.clear();
+		slirc::bench::report("destroy lightweight contexts", count, destroy.seconds());
+	}
+}
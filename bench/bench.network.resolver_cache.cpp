@@ -0,0 +1,104 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#include "benchmark.hpp"
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <vector>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include "../include/slirc/network.hpp"
+#include "../include/slirc/detail/resolver.hpp"
+
+#include "../src/network.cpp"
+
+// Looks up the same host name many times at once, as many connections do
+// when reconnecting after a network failure: once with a separate resolver
+// per lookup, once coalesced through the resolver cache, and once more with
+// the result already cached.
+//
+// Usage: bench.network.resolver_cache [lookups] [host name]
+
+namespace asio = boost::asio;
+
+namespace {
+	template<typename StartLookup>
+	void run(const std::string &name, unsigned long long count, StartLookup &&start_lookup) {
+		std::atomic<unsigned long long> remaining(count);
+		std::atomic<unsigned long long> failed(0);
+		std::promise<void> done;
+
+		const auto finished = [&](const boost::system::error_code &error) {
+			if (error) ++failed;
+			if (0 == --remaining) done.set_value();
+		};
+
+		slirc::bench::stopwatch timer;
+		for(unsigned long long i=0; i<count; ++i) {
+			start_lookup(finished);
+		}
+		done.get_future().wait();
+		slirc::bench::report(name, count, timer.seconds());
+
+		if (failed) {
+			std::cout << "  (" << failed << " lookups failed)\n";
+		}
+	}
+}
+
+int main(int argc, char **argv) {
+	const auto count = slirc::bench::iterations(argc, argv, 1000);
+	const std::string host = (argc > 2) ? argv[2] : "localhost";
+
+	asio::io_service &service = slirc::network::service();
+
+	run("separate lookups", count, [&](const std::function<void(const boost::system::error_code &)> &finished) {
+		const auto resolver = std::make_shared<asio::ip::tcp::resolver>(service);
+		resolver->async_resolve(
+			asio::ip::tcp::resolver::query(host, "6667"),
+			[resolver, finished](const boost::system::error_code &error, asio::ip::tcp::resolver::iterator) {
+				finished(error);
+			}
+		);
+	});
+
+	slirc::network::clear_resolver_cache();
+	run("coalesced lookups", count, [&](const std::function<void(const boost::system::error_code &)> &finished) {
+		slirc::network::detail::resolve(host, 6667,
+			[finished](const boost::system::error_code &error, const std::vector<asio::ip::tcp::endpoint> &) {
+				finished(error);
+			}
+		);
+	});
+
+	run("cached lookups", count, [&](const std::function<void(const boost::system::error_code &)> &finished) {
+		slirc::network::detail::resolve(host, 6667,
+			[finished](const boost::system::error_code &error, const std::vector<asio::ip::tcp::endpoint> &) {
+				finished(error);
+			}
+		);
+	});
+}
@@ -0,0 +1,78 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#include "benchmark.hpp"
+
+#include <string>
+#include <vector>
+
+#include "../include/slirc/util/line_scanner.hpp"
+
+#include "../src/util/line_scanner.cpp"
+
+// Splits a buffer of typical IRC traffic into lines, once with
+// slirc::util::index_lines() and once with a std::string::find() loop.
+
+int main(int argc, char **argv) {
+	const auto count = slirc::bench::iterations(argc, argv, 2000);
+
+	std::string data;
+	for(unsigned i=0; data.size() < 64*1024; ++i) {
+		data += ":nick" + std::to_string(i % 97) + "!user@host.example.org PRIVMSG #channel :"
+			+ std::string(10 + i * 37 % 180, 'x') + "\r\n";
+	}
+
+	std::cout
+		<< "implementation: " << slirc::util::index_lines_implementation() << "\n"
+		<< "buffer size:    " << data.size() << " bytes\n";
+
+	unsigned long long checksum = 0;
+
+	{ std::vector<slirc::util::line_span> lines;
+		slirc::bench::stopwatch timer;
+		for(unsigned long long i=0; i<count; ++i) {
+			lines.clear();
+			checksum += slirc::util::index_lines(data.data(), data.size(), lines);
+			checksum += lines.size();
+		}
+		slirc::bench::report("index_lines (64 KiB buffers)", count, timer.seconds());
+	}
+
+	{ std::vector<slirc::util::line_span> lines;
+		slirc::bench::stopwatch timer;
+		for(unsigned long long i=0; i<count; ++i) {
+			lines.clear();
+			std::string::size_type begin = 0, line_break;
+			while((line_break = data.find('\n', begin)) != std::string::npos) {
+				auto end = line_break;
+				if (begin < end && data[end-1] == '\r') --end;
+				lines.push_back(slirc::util::line_span{ begin, end - begin });
+				begin = line_break + 1;
+			}
+			checksum += begin;
+			checksum += lines.size();
+		}
+		slirc::bench::report("std::string::find (64 KiB buffers)", count, timer.seconds());
+	}
+
+	std::cout << "checksum: " << checksum << "\n";
+}
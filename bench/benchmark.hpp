@@ -0,0 +1,117 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#pragma once
+
+#ifndef SLIRC_BENCH_BENCHMARK_HPP_INCLUDED
+#define SLIRC_BENCH_BENCHMARK_HPP_INCLUDED
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#define SLIRC_BENCHMARK
+#define SLIRC_EXPORTS
+
+namespace slirc { namespace bench {
+	typedef std::chrono::steady_clock clock;
+
+	/* Measures the wall clock time since construction. */
+	struct stopwatch {
+		clock::time_point start;
+
+		stopwatch()
+		: start(clock::now()) {}
+
+		double seconds() const {
+			return std::chrono::duration<double>(clock::now() - start).count();
+		}
+	};
+
+	/* Prints a single result line in the form
+	 *   <name>: <count> ops in <seconds> s (<ops/s> ops/s, <ns/op> ns/op)
+	 */
+	inline void report(const std::string &name, unsigned long long count, double seconds) {
+		std::cout
+			<< std::left << std::setw(48) << name << std::right
+			<< std::setw(10) << count << " ops in "
+			<< std::fixed << std::setprecision(3) << seconds << " s ("
+			<< std::setprecision(0) << (seconds > 0 ? count / seconds : 0) << " ops/s, "
+			<< std::setprecision(1) << (count ? seconds * 1e9 / count : 0) << " ns/op)\n";
+	}
+
+	/* The median, 99th percentile and maximum of latency samples in ms,
+	 * printed as
+	 *   p50 <ms> ms, p99 <ms> ms, max <ms> ms (<count> samples)
+	 */
+	struct percentiles {
+		explicit percentiles(std::vector<double> samples)
+		: count(samples.size()), p50(0), p99(0), max(0) {
+			if (samples.empty()) return;
+			std::sort(samples.begin(), samples.end());
+			p50 = samples[samples.size() * 50 / 100];
+			p99 = samples[samples.size() * 99 / 100];
+			max = samples.back();
+		}
+
+		std::size_t count;
+		double p50, p99, max;
+	};
+
+	inline std::ostream &operator<<(std::ostream &out, const percentiles &p) {
+		return out << std::fixed << std::setprecision(3)
+			<< "p50 " << p.p50 << " ms, p99 " << p.p99 << " ms, max " << p.max
+			<< " ms (" << p.count << " samples)";
+	}
+
+	/* Handles the events of an irc context until the condition holds.
+	 * Returns false if no event arrived for ten seconds before that.
+	 */
+	template<typename Irc, typename Condition>
+	bool handle_events_until(Irc &irc, Condition &&condition) {
+		auto last_event = clock::now();
+		while(!condition()) {
+			if (auto e = irc.event_manager().wait_event(std::chrono::milliseconds(100))) {
+				e->handle();
+				last_event = clock::now();
+			}
+			else if (std::chrono::seconds(10) < clock::now() - last_event) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/* Reads an optional iteration count from the command line. */
+	inline unsigned long long iterations(int argc, char **argv, unsigned long long default_count) {
+		if (argc < 2) {
+			return default_count;
+		}
+		return std::strtoull(argv[1], nullptr, 10);
+	}
+}}
+
+#endif // SLIRC_BENCH_BENCHMARK_HPP_INCLUDED
@@ -0,0 +1,141 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+#pragma once
+
+#ifndef SLIRC_BENCH_RECEIVE_PIPELINE_HPP_INCLUDED
+#define SLIRC_BENCH_RECEIVE_PIPELINE_HPP_INCLUDED
+
+#include "benchmark.hpp"
+#include "../test/irc_server.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "../include/slirc/irc.hpp"
+#include "../include/slirc/apis/event_manager.hpp"
+#include "../include/slirc/modules/connection.hpp"
+
+namespace slirc { namespace bench {
+	/* Measures the lines per second reaching a handler, from the socket
+	 * through the connection and the event manager, while the stand-in
+	 * blasts pattern at a connection to endpoint. The stand-in must be
+	 * fresh.
+	 */
+	inline bool throughput(const std::string &name, slirc::test::irc_server &server, const std::string &endpoint,
+		const std::string &pattern, unsigned long long lines,
+		slirc::modules::connection::line_delivery delivery = slirc::modules::connection::line_delivery::lines
+	) {
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+		connection.set_registration("NICK bench\r\nUSER bench 0 * :Benchmark\r\n");
+		connection.set_line_delivery(delivery);
+
+		unsigned long long handled = 0;
+		irc.event_manager().connect(slirc::apis::connection::received_line, [&](slirc::event::pointer){ ++handled; });
+		irc.event_manager().connect(slirc::apis::connection::received_lines, [&](slirc::event::pointer e){
+			handled += e->components.at<slirc::apis::connection::received_line_batch>().size();
+		});
+
+		connection.connect(endpoint);
+		if (!server.wait_for_registrations(1) || !handle_events_until(irc, [&]{ return handled == 1; })) {
+			std::cout << name << ": not registered\n";
+			return false;
+		}
+
+		const unsigned long long per_pattern = std::count(pattern.begin(), pattern.end(), '\n');
+		const unsigned long long repeats = std::max(1ULL, lines / per_pattern);
+		const unsigned long long expected = 1 + repeats * per_pattern;
+
+		stopwatch timer;
+		server.blast(pattern, repeats);
+		const bool complete = handle_events_until(irc, [&]{ return handled == expected; });
+		const double seconds = timer.seconds();
+		const auto reads = connection.get_traffic_stats().reads;
+		connection.disconnect();
+
+		if (!complete) {
+			std::cout << name << ": only " << handled - 1 << " of " << expected - 1 << " lines arrived\n";
+			return false;
+		}
+		report(name, expected - 1, seconds);
+		std::cout << "  " << reads << " reads\n";
+		return true;
+	}
+
+	/* Measures the round trip of a handler replying to a message, as seen
+	 * by the stand-in, which sends the next message as soon as the reply to
+	 * the previous one arrived. The stand-in must be fresh.
+	 */
+	inline bool round_trips(const std::string &name, slirc::test::irc_server &server, const std::string &endpoint,
+		unsigned long long count
+	) {
+		std::vector<double> samples;
+		std::atomic<bool> done(false);
+		clock::time_point sent;
+		const auto send_next = [&]{
+			sent = clock::now();
+			server.send(":peer!peer@example.org PRIVMSG bench :ping " + std::to_string(samples.size()) + "\r\n");
+		};
+		server.on_line([&](const std::string &line){
+			if (line.compare(0, 20, "PRIVMSG #bench :pong") != 0) return;
+			samples.push_back(std::chrono::duration<double, std::milli>(clock::now() - sent).count());
+			if (samples.size() < count) {
+				send_next();
+			}
+			else {
+				done = true;
+			}
+		});
+
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+		connection.set_registration("NICK bench\r\nUSER bench 0 * :Benchmark\r\n");
+		connection.set_socket_options(slirc::modules::connection::socket_options{ true, false, 0, false });
+		irc.event_manager().connect(slirc::apis::connection::received_line, [&](slirc::event::pointer e){
+			const std::string &line = e->components.at<slirc::apis::connection::received_data>().data();
+			const auto ping = line.find(" :ping ");
+			if (ping != std::string::npos) {
+				connection.send_raw("PRIVMSG #bench :pong " + line.substr(ping + 7) + "\r\n");
+			}
+		});
+
+		connection.connect(endpoint);
+		if (!server.wait_for_registrations(1)) {
+			std::cout << name << ": not registered\n";
+			return false;
+		}
+		send_next();
+		const bool complete = handle_events_until(irc, [&]{ return done.load(); });
+		connection.disconnect();
+
+		if (!complete) {
+			std::cout << name << ": stalled\n";
+			return false;
+		}
+		std::cout << std::left << std::setw(48) << name << std::right << percentiles(samples) << "\n";
+		return true;
+	}
+}}
+
+#endif // SLIRC_BENCH_RECEIVE_PIPELINE_HPP_INCLUDED
@@ -0,0 +1,184 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#pragma once
+
+#ifndef SLIRC_BENCH_TLS_SERVER_HPP_INCLUDED
+#define SLIRC_BENCH_TLS_SERVER_HPP_INCLUDED
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/ssl/stream.hpp>
+#include <boost/asio/write.hpp>
+
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+
+namespace slirc { namespace bench {
+	/* A TLS server stand-in in the spirit of "openssl s_server": it listens
+	 * on the loopback interface with a freshly generated self-signed
+	 * certificate, completes the handshake with every client, sends a
+	 * greeting line and then discards everything it receives, or echoes it
+	 * back. While reject_handshakes is set, it closes connections right
+	 * after accepting them instead, so the clients' handshakes fail.
+	 *
+	 * It runs on its own thread and io_service, so it does not compete with
+	 * the client for slirc::network::service().
+	 */
+	class tls_server {
+	public:
+		explicit tls_server(bool echo = false, const std::string &greeting = ":stand-in 001 bench :Welcome\r\n")
+		: reject_handshakes(false)
+		, accepted(0)
+		, handshakes(0)
+		, resumed(0)
+		, echo(echo)
+		, greeting(greeting)
+		, context(boost::asio::ssl::context::sslv23_server)
+		, acceptor(service, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)) {
+			use_self_signed_certificate();
+			accept_next();
+			thread = std::thread([this]{ service.run(); });
+		}
+
+		~tls_server() {
+			service.stop();
+			thread.join();
+		}
+
+		unsigned short port() const {
+			return acceptor.local_endpoint().port();
+		}
+
+		std::atomic<bool> reject_handshakes;
+		std::atomic<unsigned long long> accepted;
+		std::atomic<unsigned long long> handshakes; // completed
+		std::atomic<unsigned long long> resumed;    // of which resumed a session
+
+	private:
+		typedef boost::asio::ssl::stream<boost::asio::ip::tcp::socket> stream;
+
+		struct client: std::enable_shared_from_this<client> {
+			client(boost::asio::io_service &service, boost::asio::ssl::context &context, bool echo)
+			: tls(service, context)
+			, echo(echo) {}
+
+			void serve() {
+				auto self = shared_from_this();
+				tls.async_read_some(boost::asio::buffer(buffer),
+					[self](const boost::system::error_code &error, std::size_t bytes_transferred) {
+						if (error) return;
+						if (!self->echo) {
+							self->serve();
+							return;
+						}
+						boost::asio::async_write(self->tls, boost::asio::buffer(self->buffer, bytes_transferred),
+							[self](const boost::system::error_code &error, std::size_t) {
+								if (!error) self->serve();
+							});
+					});
+			}
+
+			stream tls;
+			const bool echo;
+			char buffer[4096];
+		};
+
+		void use_self_signed_certificate() {
+			EVP_PKEY *key = nullptr;
+			EVP_PKEY_CTX *keygen = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+			if (!keygen
+				|| EVP_PKEY_keygen_init(keygen) <= 0
+				|| EVP_PKEY_CTX_set_ec_paramgen_curve_nid(keygen, NID_X9_62_prime256v1) <= 0
+				|| EVP_PKEY_keygen(keygen, &key) <= 0
+			) {
+				EVP_PKEY_CTX_free(keygen);
+				throw std::runtime_error("tls_server: cannot generate a key");
+			}
+			EVP_PKEY_CTX_free(keygen);
+
+			X509 *cert = X509_new();
+			X509_set_version(cert, 2);
+			ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+			X509_gmtime_adj(X509_getm_notBefore(cert), 0);
+			X509_gmtime_adj(X509_getm_notAfter(cert), 24*60*60);
+			X509_set_pubkey(cert, key);
+			X509_NAME *name = X509_get_subject_name(cert);
+			X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+				reinterpret_cast<const unsigned char *>("localhost"), -1, -1, 0);
+			X509_set_issuer_name(cert, name);
+			const bool ok = X509_sign(cert, key, EVP_sha256()) > 0
+				&& SSL_CTX_use_certificate(context.native_handle(), cert) == 1
+				&& SSL_CTX_use_PrivateKey(context.native_handle(), key) == 1;
+			X509_free(cert);
+			EVP_PKEY_free(key);
+			if (!ok) {
+				throw std::runtime_error("tls_server: cannot set up the certificate");
+			}
+		}
+
+		void accept_next() {
+			auto next = std::make_shared<client>(service, context, echo);
+			acceptor.async_accept(next->tls.lowest_layer(),
+				[this, next](const boost::system::error_code &error) {
+					if (error) return;
+					accept_next();
+					++accepted;
+					if (reject_handshakes) {
+						boost::system::error_code ec;
+						next->tls.lowest_layer().close(ec);
+						return;
+					}
+					next->tls.async_handshake(stream::server,
+						[this, next](const boost::system::error_code &error) {
+							if (error) return;
+							++handshakes;
+							if (SSL_session_reused(next->tls.native_handle())) {
+								++resumed;
+							}
+							boost::asio::async_write(next->tls, boost::asio::buffer(greeting),
+								[next](const boost::system::error_code &error, std::size_t) {
+									if (!error) next->serve();
+								});
+						});
+				});
+		}
+
+		const bool echo;
+		const std::string greeting;
+		boost::asio::io_service service;
+		boost::asio::ssl::context context;
+		boost::asio::ip::tcp::acceptor acceptor;
+		std::thread thread;
+	};
+}}
+
+#endif // SLIRC_BENCH_TLS_SERVER_HPP_INCLUDED
@@ -32,6 +32,9 @@ int main(int argc, char **argv) {
 	slirc::irc irc;
 	auto &connection = irc.load<slirc::modules::connection>();
 
+	// PINGs are answered by the connection itself, but still shown below
+	connection.set_keepalive(slirc::modules::connection::keepalive::answer_and_emit);
+
 	connection.connect("irc://irc.freenode.org:6667");
 
 	irc.event_manager().connect(
@@ -45,7 +48,7 @@ int main(int argc, char **argv) {
 	irc.event_manager().connect(
 		slirc::modules::connection::received_line,
 		[&](slirc::event::pointer e){
-			std::string &data = e->components.at<slirc::apis::connection::received_data>().data;
+			const std::string &data = e->components.at<slirc::apis::connection::received_data>().data();
 			std::cout << data << "\n";
 
 			if (std::string::npos != data.find(" 001 ")) {
@@ -55,9 +58,7 @@ int main(int argc, char **argv) {
 			if (data.substr(0,5) == "PING ") {
 				std::string pong = data + "\r\n";
 				pong[1] = 'O';
-				connection.send_raw(pong.c_str(), pong.size());
-				pong = "PRIVMSG #php.bottest :"+pong;
-				connection.send_raw(pong.c_str(), pong.size());
+				connection.send_raw("PRIVMSG #php.bottest :" + pong);
 			}
 		}
 	);
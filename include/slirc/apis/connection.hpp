@@ -27,8 +27,17 @@
 
 #include "../detail/system.hpp"
 
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
 #include "../event.hpp"
 #include "../module.hpp"
+#include "../util/line_scanner.hpp"
+#include "../util/noncopyable.hpp"
+#include "../util/string_view.hpp"
 
 namespace slirc {
 
@@ -99,25 +108,268 @@ struct SLIRCAPI connection: module<connection> {
 		 *
 		 * Contains a \c received_data component.
 		 */
-		received_line
+		received_line,
+
+		/**
+		 * Raised when lines are received from the IRC server, if the
+		 * connection is configured to deliver batches of lines.
+		 *
+		 * Contains a \c received_line_batch component.
+		 */
+		received_lines
 	};
 
 	/** Contains the data received from the connection.
 	 *
 	 * Is attached to a \c received_line event.
+	 *
+	 * The line is not copied out of the buffer it was received into; instead
+	 * the component shares ownership of that buffer and refers to the line
+	 * within it.
 	 */
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Weffc++"
 	struct received_data: component<received_data> {
+		SLIRC_RECYCLABLE_COMPONENT(received_data);
+
+		/** Constructs an empty line.
+		 */
+		received_data()
+		: buffer_()
+		, length_(0)
+		, data_()
+		, materialized_(true) {}
+
+		/** Constructs a line owning a copy of the given data.
+		 *
+		 * \param line The line of data.
+		 */
+		explicit received_data(std::string line)
+		: buffer_()
+		, length_(line.size())
+		, data_(std::move(line))
+		, materialized_(true) {}
+
+		/** Refers to a line within a shared buffer.
+		 *
+		 * \param buffer A pointer to the first character of the line. The
+		 *        component shares ownership of the buffer it points into.
+		 * \param length The length of the line.
+		 */
+		void assign(std::shared_ptr<const char> buffer, std::size_t length) {
+			buffer_ = std::move(buffer);
+			length_ = length;
+			data_.clear();
+			materialized_ = false;
+		}
+
 		/** The line of data received by the connection.
 		 *
 		 * Leading whitespace and the line break are removed. Whitespace
 		 * between arguments is not normalized.
+		 *
+		 * \return A view of the line, valid as long as this component exists
+		 *         and is not modified.
 		 */
-		std::string data;
+		util::string_view line() const {
+			return materialized_
+				? util::string_view(data_)
+				: util::string_view(buffer_.get(), length_);
+		}
+
+		/** The line of data received by the connection.
+		 *
+		 * Same as \c line(), but as a string. The string is only created
+		 * on the first call.
+		 *
+		 * \return The line of data received by the connection.
+		 *
+		 * \note Unlike \c line(), this function must not be called
+		 *       concurrently on the same component.
+		 */
+		const std::string &data() const {
+			if (!materialized_) {
+				data_.assign(buffer_.get(), length_);
+				materialized_ = true;
+				buffer_.reset(); // no longer needed
+			}
+			return data_;
+		}
+
+		/** Clears the data, keeping the capacity of the materialized string
+		 *  for recycling.
+		 */
+		void reset() {
+			buffer_.reset();
+			length_ = 0;
+			data_.clear();
+			materialized_ = true;
+		}
+
+	private:
+		mutable std::shared_ptr<const char> buffer_;
+		std::size_t length_;
+		mutable std::string data_;
+		mutable bool materialized_;
 	};
 #pragma GCC diagnostic pop
 
+	/** Contains all lines received from the connection in one read.
+	 *
+	 * Is attached to a \c received_lines event.
+	 *
+	 * The lines are kept in the buffer they were received into, which the
+	 * component shares ownership of, and are described by a table of offsets
+	 * into that buffer.
+	 */
+	struct received_line_batch: component<received_line_batch> {
+		SLIRC_RECYCLABLE_COMPONENT(received_line_batch);
+
+		/** Constructs an empty batch.
+		 */
+		received_line_batch()
+		: buffer_()
+		, lines_() {}
+
+		/** Sets the buffer the lines are located in and removes all lines.
+		 *
+		 * \param buffer A pointer to the start of the buffer. The component
+		 *        shares ownership of the buffer it points into.
+		 */
+		void assign(std::shared_ptr<const char> buffer) {
+			buffer_ = std::move(buffer);
+			lines_.clear();
+		}
+
+		/** Adds a line.
+		 *
+		 * \param begin The offset of the line within the buffer.
+		 * \param length The length of the line.
+		 */
+		void add(std::size_t begin, std::size_t length) {
+			lines_.push_back(util::line_span{ begin, length });
+		}
+
+		/** The number of lines in this batch.
+		 */
+		std::size_t size() const {
+			return lines_.size();
+		}
+
+		/** Checks whether this batch contains no lines.
+		 */
+		bool empty() const {
+			return lines_.empty();
+		}
+
+		/** A line of data received by the connection.
+		 *
+		 * Leading whitespace and the line break are removed, as in
+		 * \c received_data::line().
+		 *
+		 * \param index The index of the line; must be less than \c size().
+		 *
+		 * \return A view of the line, valid as long as this component exists
+		 *         and is not modified.
+		 */
+		util::string_view operator[](std::size_t index) const {
+			return util::string_view(buffer_.get() + lines_[index].begin, lines_[index].length);
+		}
+
+		/** The buffer the lines are located in.
+		 */
+		const std::shared_ptr<const char> &buffer() const {
+			return buffer_;
+		}
+
+		/** The offsets and lengths of all lines within \c buffer().
+		 */
+		const std::vector<util::line_span> &lines() const {
+			return lines_;
+		}
+
+		/** Creates a \c received_data component for a single line.
+		 *
+		 * The component refers to the line within the shared buffer instead
+		 * of copying it.
+		 *
+		 * \param index The index of the line; must be less than \c size().
+		 *
+		 * \return The \c received_data component for the line.
+		 */
+		received_data line_data(std::size_t index) const {
+			received_data result;
+			result.assign(
+				std::shared_ptr<const char>(buffer_, buffer_.get() + lines_[index].begin),
+				lines_[index].length);
+			return result;
+		}
+
+		/** Removes all lines, keeping the capacity of the offset table for
+		 *  recycling.
+		 */
+		void reset() {
+			buffer_.reset();
+			lines_.clear();
+		}
+
+	private:
+		std::shared_ptr<const char> buffer_;
+		std::vector<util::line_span> lines_;
+	};
+
+	/** \brief A snapshot of the traffic on a connection.
+	 *
+	 * Unless noted otherwise, the counters span all connects made by the
+	 * connection.
+	 */
+	struct traffic_stats {
+		/// \brief The number of bytes received.
+		unsigned long long bytes_in;
+
+		/// \brief The number of bytes written.
+		unsigned long long bytes_out;
+
+		/// \brief The number of non-empty lines received.
+		unsigned long long lines_in;
+
+		/// \brief The number of lines written.
+		unsigned long long lines_out;
+
+		/// \brief The number of completed reads.
+		unsigned long long reads;
+
+		/// \brief The number of writes issued.
+		unsigned long long writes;
+
+		/** \brief The number of bytes received but not yet handed out as
+		 *         lines, i.e. the length of a partially received line.
+		 */
+		std::size_t receive_buffered;
+
+		/// \brief The number of bytes waiting to be written.
+		std::size_t send_queued;
+
+		/** \brief The time the current connection has been established for;
+		 *         zero if it is not established.
+		 */
+		std::chrono::steady_clock::duration connected_for;
+
+		/** \brief The number of times the connection was established again
+		 *         after it had been established before.
+		 */
+		unsigned long long reconnects;
+
+		/** \brief The smoothed round trip time of PINGs sent through this
+		 *         connection.
+		 *
+		 * Each PONG answering a PING sent with \c send_raw() is a sample;
+		 * samples are averaged as TCP does for its round trip time, with
+		 * each new sample weighing 1/8. Zero until the first PONG arrives.
+		 */
+		std::chrono::steady_clock::duration ping_rtt;
+	};
+
 	/** \brief Connects to the IRC server.
 	 *
 	 * \throw slirc::exceptions::already_connected if the connection is not
@@ -174,9 +426,52 @@ struct SLIRCAPI connection: module<connection> {
 	 * \note The passed data will be appended to the send queue.
 	 */
 	inline void send_raw(const char *data) {
-		unsigned length=0;
-		while(data[length]) ++length;
-		do_send_raw(data, length);
+		do_send_raw(data, std::strlen(data));
+	}
+
+	/** \brief Sends data to the server.
+	 *
+	 * If the connection is established, the data passed is added to the send
+	 * queue and sent at the next possible opportunity.
+	 *
+	 * \param data The data to send.
+	 *
+	 * \note The passed data will be appended to the send queue.
+	 */
+	inline void send_raw(const std::string &data) {
+		do_send_raw(data.data(), data.size());
+	}
+
+	/** \brief Sends data to the server without copying it.
+	 *
+	 * If the connection is established, the data passed is added to the send
+	 * queue and sent at the next possible opportunity.
+	 *
+	 * \param data The data to send. The connection takes ownership of the
+	 *        string until it has been sent.
+	 *
+	 * \note The passed data will be appended to the send queue.
+	 */
+	inline void send_raw(std::string &&data) {
+		const std::size_t length = data.size();
+		const auto owner = std::make_shared<const std::string>(std::move(data));
+		do_send_raw(std::shared_ptr<const char>(owner, owner->data()), length);
+	}
+
+	/** \brief Sends data to the server without copying it.
+	 *
+	 * If the connection is established, the data passed is added to the send
+	 * queue and sent at the next possible opportunity.
+	 *
+	 * \param data A pointer to the data to send. The connection shares
+	 *        ownership of the buffer it points into until the data has been
+	 *        sent. The data must not be modified in the meantime.
+	 * \param length The length of the data.
+	 *
+	 * \note The passed data will be appended to the send queue.
+	 */
+	inline void send_raw(std::shared_ptr<const char> data, std::size_t length) {
+		do_send_raw(std::move(data), length);
 	}
 
 	/** \brief Sends data to the server.
@@ -198,7 +493,96 @@ struct SLIRCAPI connection: module<connection> {
 		do_send_raw(data, length);
 	}
 
+	/** \brief Holds back sending data.
+	 *
+	 * Data sent while the connection is corked is queued, and sent in as
+	 * few writes as possible once the connection is uncorked again. Calls
+	 * can be nested; the data is sent when \c uncork() has been called as
+	 * often as \c cork().
+	 *
+	 * Only the data sent by the calling thread is held back; data sent by
+	 * other threads in the meantime, e.g. the answers to PINGs, is sent as
+	 * usual. Data held back across a disconnect is dropped.
+	 *
+	 * \note The default implementation does nothing; data is sent as usual.
+	 */
+	inline void cork() {
+		do_cork();
+	}
+
+	/** \brief Releases data held back by \c cork().
+	 *
+	 * \note Must only be called after a matching call to \c cork() from
+	 *       the same thread.
+	 */
+	inline void uncork() {
+		do_uncork();
+	}
+
+	/** \brief Corks a connection for the lifetime of this object.
+	 *
+	 * Use this to send multiple lines in a single write:
+	 * \code
+	 * {
+	 *     slirc::apis::connection::batch batch(connection);
+	 *     connection.send_raw("JOIN #a\r\n");
+	 *     connection.send_raw("JOIN #b\r\n");
+	 * } // both lines are sent here
+	 * \endcode
+	 */
+	class batch: util::noncopyable {
+		connection &connection_;
+
+	public:
+		/** \brief Corks the connection.
+		 *
+		 * \param connection_to_cork The connection to cork.
+		 */
+		explicit batch(connection &connection_to_cork)
+		: connection_(connection_to_cork) {
+			connection_.cork();
+		}
+
+		/** \brief Uncorks the connection.
+		 */
+		~batch() {
+			connection_.uncork();
+		}
+	};
+
+	/** \brief Returns a snapshot of the traffic on the connection.
+	 *
+	 * Taking the snapshot does not lock the connection, so it is cheap
+	 * enough to be polled frequently. The fields are read one by one and
+	 * may therefore be slightly inconsistent with each other.
+	 *
+	 * \note The default implementation returns all zeros.
+	 */
+	inline traffic_stats get_traffic_stats() {
+		return do_get_traffic_stats();
+	}
+
 protected:
+	/** \brief Holds back sending data.
+	 *
+	 * \see cork()
+	 */
+	virtual void do_cork() {}
+
+	/** \brief Releases data held back by \c do_cork().
+	 *
+	 * \see uncork()
+	 */
+	virtual void do_uncork() {}
+
+	/** \brief Returns a snapshot of the traffic on the connection.
+	 *
+	 * \see get_traffic_stats()
+	 */
+	virtual traffic_stats do_get_traffic_stats() {
+		return traffic_stats();
+	}
+
 	/** \brief Sends data to the server.
 	 *
 	 * If the connection is established, the data passed is added to the send
@@ -210,6 +594,24 @@ protected:
 	 * \note The passed data will be appended to the send queue.
 	 */
 	virtual void do_send_raw(const char *data, std::size_t length) = 0;
+
+	/** \brief Sends data to the server without copying it.
+	 *
+	 * If the connection is established, the data passed is added to the send
+	 * queue and sent at the next possible opportunity.
+	 *
+	 * The default implementation copies the data by passing it to the other
+	 * overload of \c do_send_raw().
+	 *
+	 * \param data A pointer to the data to send, sharing ownership of the
+	 *        buffer it points into.
+	 * \param length The length of the data.
+	 *
+	 * \note The passed data will be appended to the send queue.
+	 */
+	virtual void do_send_raw(std::shared_ptr<const char> data, std::size_t length) {
+		do_send_raw(data.get(), length);
+	}
 };
 
 SLIRC_REGISTER_EVENT_ID_ENUM(connection::state);
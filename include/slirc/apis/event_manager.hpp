@@ -56,8 +56,15 @@ protected:
 	 * Added to events on call of event::afterwards()
 	 */
 	struct handle_afterwards: component<handle_afterwards> {
+		SLIRC_RECYCLABLE_COMPONENT(handle_afterwards);
+
 		/// \brief Contains the events.
 		std::vector<event::pointer> events;
+
+		/// \brief Clears the events, keeping their capacity for recycling.
+		void reset() {
+			events.clear();
+		}
 	};
 #pragma GCC diagnostic pop
 
@@ -318,6 +325,26 @@ public:
 	 */
 	virtual void wait_event(event_consumer_type callback) = 0;
 
+	/** \brief Discards the queued events of an IRC context.
+	 *
+	 * Is called by a lightweight IRC context sharing this event manager when
+	 * it is destructed, so none of its events is handled afterwards. Events
+	 * queued for another context constructed at the same address later on
+	 * must not be affected.
+	 *
+	 * The default implementation does nothing, which is only safe for event
+	 * managers not shared with lightweight contexts, or whose queue is
+	 * drained before such contexts are destructed.
+	 *
+	 * \param context The IRC context whose events are to be discarded.
+	 *
+	 * \note Events already taken from the queue are not affected.
+	 * \note This function is thread safe.
+	 */
+	virtual void discard_events(const slirc::irc &context) {
+		((void)context); // unused parameter
+	}
+
 protected:
 	/** \brief Initializes a connection for an event handler.
 	 *
@@ -27,14 +27,64 @@
 
 #include "detail/system.hpp"
 
+#include <type_traits>
+
+/** \def SLIRC_RECYCLABLE_COMPONENT(type)
+ *
+ * \brief Enables recycling of a base component type.
+ *
+ * \param type The unqualified name of the base component type being defined.
+ *
+ * Must be used inside the definition of the base component type. Instances of
+ * recyclable components are not freed when they are removed from an
+ * slirc::component_container, but returned to a process wide pool for their
+ * type and reused on the next insertion.
+ *
+ * If the component has a member function \c reset(), it is called when the
+ * component is returned to the pool instead of destructing it, so any memory
+ * held by its members (e.g. the capacity of strings or vectors) is kept for
+ * the next use. \c reset() must return the component into a state equivalent
+ * to a default constructed one. Newly inserted values are copy assigned to
+ * the recycled instance, so its members keep their buffers; components that
+ * cannot be copy assigned are move assigned. Without \c reset(), only the
+ * storage of the component itself is reused.
+ *
+ * \code
+ *     struct my_component: slirc::component<my_component> {
+ *         SLIRC_RECYCLABLE_COMPONENT(my_component);
+ *
+ *         std::string text;
+ *         void reset() { text.clear(); }
+ *     };
+ * \endcode
+ *
+ * \note Only instances of exactly the base component type are recycled.
+ *       Instances of derived components are allocated and freed as usual.
+ */
+
+#undef SLIRC_RECYCLABLE_COMPONENT
+#define SLIRC_RECYCLABLE_COMPONENT(type) \
+	friend constexpr std::true_type slirc_impldetail_enable_component_recycling(type*)
+
 namespace slirc {
 
 struct component_container;
 
+// only declared, never defined!
+template<typename NotRecyclable>
+constexpr std::false_type slirc_impldetail_enable_component_recycling(NotRecyclable*);
+
 namespace detail {
 	struct component_base {
 		virtual ~component_base() = default;
 	};
+
+	template<typename Component>
+	constexpr bool is_recyclable_component() {
+		return
+			std::is_same<Component, typename Component::component_base_type>::value &&
+			decltype(slirc_impldetail_enable_component_recycling(static_cast<Component*>(nullptr)))::value;
+	}
 }
 
 /** \brief
@@ -28,13 +28,20 @@
 #include "detail/system.hpp"
 
 #include <cassert>
+#include <cstddef>
 
+#include <algorithm>
+#include <initializer_list>
+#include <iterator>
 #include <memory>
+#include <mutex>
+#include <new>
 #include <typeinfo>
 #include <typeindex>
 #include <type_traits>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "component.hpp"
 #include "exceptions.hpp"
@@ -63,6 +70,185 @@ namespace detail {
 				T
 			>::value;
 	}
+
+	constexpr bool all_of(std::initializer_list<bool> values) {
+		for(bool value : values) {
+			if (!value) return false;
+		}
+		return true;
+	}
+
+	template<typename Component>
+	struct has_reset {
+	private:
+		template<typename T>
+		static auto check(T *t) -> decltype(t->reset(), std::true_type());
+		static std::false_type check(...);
+
+	public:
+		typedef decltype(check(static_cast<Component*>(nullptr))) type;
+	};
+
+	inline void delete_component(component_base *c) {
+		delete c;
+	}
+
+	struct component_deleter {
+		void (*destroy)(component_base *) = &delete_component;
+
+		void operator()(component_base *c) const {
+			destroy(c);
+		}
+	};
+
+	/* Process wide free list for a recyclable base component type.
+	 *
+	 * If the component has a reset() hook, the free list holds reset, but
+	 * still constructed instances, otherwise it only holds raw storage.
+	 */
+	template<typename Component>
+	class component_pool {
+		typedef typename has_reset<Component>::type keeps_instances;
+
+		static_assert(alignof(Component) <= alignof(std::max_align_t),
+			"Recyclable components must not be over-aligned.");
+
+		std::mutex mutex;
+		/* ^ */ std::vector<void*> free_list;
+		/* ^ */ std::size_t limit;
+
+		component_pool()
+		: mutex()
+		, free_list()
+		, limit(256) {}
+
+		static component_pool &instance() {
+			// intentionally leaked: components may still be released during
+			// static destruction, after a static pool would be gone already
+			static component_pool &pool = *new component_pool;
+			return pool;
+		}
+
+		static void dispose(void *storage, std::true_type) {
+			static_cast<Component*>(storage)->~Component();
+			::operator delete(storage);
+		}
+
+		static void dispose(void *storage, std::false_type) {
+			::operator delete(storage);
+		}
+
+		// copy assigning fills the buffers the members of the recycled
+		// instance kept, where move assigning would replace them with those
+		// of the (usually empty) new value
+		static void assign(Component &c, Component &&value, std::true_type) {
+			c = static_cast<const Component &>(value);
+		}
+
+		static void assign(Component &c, Component &&value, std::false_type) {
+			c = std::move(value);
+		}
+
+		static Component *construct(void *storage, Component &&value, std::true_type) {
+			if (storage) {
+				Component *c = static_cast<Component*>(storage);
+				try {
+					assign(*c, std::move(value), std::is_copy_assignable<Component>());
+				}
+				catch(...) {
+					release(c);
+					throw;
+				}
+				return c;
+			}
+			return construct(nullptr, std::move(value), std::false_type());
+		}
+
+		static Component *construct(void *storage, Component &&value, std::false_type) {
+			if (!storage) {
+				storage = ::operator new(sizeof(Component));
+			}
+			try {
+				return new(storage) Component(std::move(value));
+			}
+			catch(...) {
+				::operator delete(storage);
+				throw;
+			}
+		}
+
+		static void *recycle(Component *c, std::true_type) {
+			try {
+				c->reset();
+			}
+			catch(...) {
+				c->~Component();
+				::operator delete(c);
+				return nullptr;
+			}
+			return c;
+		}
+
+		static void *recycle(Component *c, std::false_type) {
+			c->~Component();
+			return c;
+		}
+
+	public:
+		static Component *acquire(Component &&value) {
+			component_pool &pool = instance();
+			void *storage = nullptr;
+
+			{ std::unique_lock<std::mutex> lock(pool.mutex);
+				if (!pool.free_list.empty()) {
+					storage = pool.free_list.back();
+					pool.free_list.pop_back();
+				}
+			}
+
+			return construct(storage, std::move(value), keeps_instances());
+		}
+
+		static void release(Component *c) noexcept {
+			void *storage = recycle(c, keeps_instances());
+			if (!storage) return;
+
+			component_pool &pool = instance();
+			{ std::unique_lock<std::mutex> lock(pool.mutex);
+				if (pool.free_list.size() < pool.limit) {
+					try {
+						pool.free_list.push_back(storage);
+						return;
+					}
+					catch(std::bad_alloc&) {}
+				}
+			}
+			dispose(storage, keeps_instances());
+		}
+
+		static void set_limit(std::size_t new_limit) {
+			component_pool &pool = instance();
+			std::vector<void*> excess;
+
+			{ std::unique_lock<std::mutex> lock(pool.mutex);
+				pool.limit = new_limit;
+				if (new_limit < pool.free_list.size()) {
+					excess.assign(pool.free_list.begin() + new_limit, pool.free_list.end());
+					pool.free_list.resize(new_limit);
+				}
+			}
+
+			for(void *storage : excess) {
+				dispose(storage, keeps_instances());
+			}
+		}
+
+		static std::size_t size() {
+			component_pool &pool = instance();
+			std::unique_lock<std::mutex> lock(pool.mutex);
+			return pool.free_list.size();
+		}
+	};
 }
 
 
@@ -82,9 +268,28 @@ struct component_container: private util::noncopyable {
 	friend class ::slirc::test::test_overrides;
 
 private:
-	typedef std::unordered_map<std::type_index, std::unique_ptr<detail::component_base>> contents_type;
+	typedef std::unordered_map<std::type_index, std::unique_ptr<detail::component_base, detail::component_deleter>> contents_type;
 	contents_type contents{};
 
+	template<typename Component>
+	static void recycle_(detail::component_base *c) {
+		detail::component_pool<Component>::release(
+			static_cast<Component*>(static_cast<component<Component>*>(c)));
+	}
+
+	template<typename Component>
+	static contents_type::mapped_type make_(Component &&value, std::false_type) {
+		return contents_type::mapped_type(
+			new Component(std::forward<Component&&>(value)));
+	}
+
+	template<typename Component>
+	static contents_type::mapped_type make_(Component &&value, std::true_type) {
+		return contents_type::mapped_type(
+			detail::component_pool<Component>::acquire(std::forward<Component&&>(value)),
+			detail::component_deleter{ &recycle_<Component> });
+	}
+
 	template<typename Component>
 	contents_type::iterator find_() {
 		return contents.find(typeid(typename Component::component_base_type));
@@ -97,14 +302,27 @@ private:
 
 	template<typename Component>
 	Component &insert_(Component &&value) {
+		contents_type::mapped_type c = make_<Component>(
+			std::forward<Component&&>(value),
+			std::integral_constant<bool, detail::is_recyclable_component<Component>()>());
+
 		return static_cast<Component&>(*(
-			contents[typeid(typename Component::component_base_type)] =
-				contents_type::mapped_type(
-					new Component(std::forward<Component&&>(value))
-				)
+			contents[typeid(typename Component::component_base_type)] = std::move(c)
 		));
 	}
 
+	template<typename Component>
+	contents_type::iterator prepare_move_(const component_container &target) {
+		auto it = find_<Component>();
+		if (it == contents.end()) {
+			return it;
+		}
+		if (!find<Component>() || target.contents.count(it->first)) {
+			throw exceptions::component_conflict();
+		}
+		return it;
+	}
+
 public:
 	/** \brief Inserts a new component.
 	 *
@@ -359,6 +577,98 @@ public:
 		}
 		throw exceptions::component_conflict();
 	}
+
+	/** \brief Moves all components into another container.
+	 *
+	 * \param target The container to move the components into.
+	 *
+	 * Ownership of the stored component objects is handed over to \c target;
+	 * no component is copied, moved or reallocated. References and pointers
+	 * to the components stay valid, but now refer to components in \c target.
+	 * Afterwards this container is empty.
+	 *
+	 * \throw slirc::exceptions::component_conflict
+	 *     if \c target contains a component of the same base type as any
+	 *     component in this container. No component is moved in this case.
+	 *
+	 * \note Transferring a container into itself does nothing.
+	 */
+	void transfer_to(component_container &target) {
+		if (&target == this) {
+			return;
+		}
+
+		for(const auto &c : contents) {
+			if (target.contents.count(c.first)) {
+				throw exceptions::component_conflict();
+			}
+		}
+
+		target.contents.merge(contents);
+		SLIRC_ASSERT( contents.empty() && "All components should have been transferred." );
+	}
+
+	/** \brief Moves specific components into another container.
+	 *
+	 * \tparam Components
+	 *     The types of the components to be moved.
+	 *
+	 * \param target The container to move the components into.
+	 *
+	 * Ownership of the requested components is handed over to \c target
+	 * without copying, moving or reallocating the component objects. Requested
+	 * components not present in this container are skipped.
+	 *
+	 * \return The number of components moved.
+	 *
+	 * \throw slirc::exceptions::component_conflict
+	 *     if this container contains a mismatching component for any of the
+	 *     requested types (i.e.: if at() would throw), or if \c target
+	 *     already contains a component of the same base type as any component
+	 *     to be moved. No component is moved in this case.
+	 */
+	template<typename... Components>
+	std::size_t move(component_container &target) {
+		static_assert(detail::all_of({ detail::is_valid_component<Components>()... }),
+			"Supplied types for Components are not all valid as components.");
+
+		if (&target == this) {
+			return 0;
+		}
+
+		// trailing end() avoids an empty array for an empty parameter pack
+		const contents_type::iterator found[] = { prepare_move_<Components>(target)..., contents.end() };
+
+		std::size_t num_moved = 0;
+		for(auto it = std::begin(found); it != std::end(found); ++it) {
+			// the same component might have been requested more than once
+			if (*it != contents.end() && std::find(std::begin(found), it, *it) == it) {
+				target.contents.insert(contents.extract(*it));
+				++num_moved;
+			}
+		}
+		return num_moved;
+	}
+
+	/** \brief Limits the number of idle instances kept for recycling.
+	 *
+	 * \tparam Component
+	 *     The recyclable base component type to set the limit for.
+	 *
+	 * \param limit
+	 *     The maximum number of removed instances kept around for reuse.
+	 *     Instances removed while the limit is reached are freed. Idle
+	 *     instances exceeding a lowered limit are freed immediately.
+	 *     Defaults to 256.
+	 *
+	 * \note See SLIRC_RECYCLABLE_COMPONENT() for how to make a component
+	 *       recyclable.
+	 */
+	template<typename Component>
+	static void set_recycling_limit(std::size_t limit) {
+		static_assert(detail::is_recyclable_component<Component>(), "Supplied type for Component is not a recyclable base component.");
+		detail::component_pool<Component>::set_limit(limit);
+	}
 };
 
 /** \brief Enables derived classes to hold components.
@@ -0,0 +1,56 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#pragma once
+
+#ifndef SLIRC_DETAIL_HANDSHAKE_POOL_HPP_INCLUDED
+#define SLIRC_DETAIL_HANDSHAKE_POOL_HPP_INCLUDED
+
+#include "system.hpp"
+
+namespace boost { namespace asio {
+	struct io_service;
+}}
+
+namespace slirc {
+namespace network {
+namespace detail {
+
+/** \brief Get the ASIO service of the TLS handshake pool.
+ *
+ * \return The service run by the threads of the handshake pool, or
+ *         \c nullptr if handshakes are to run on
+ *         \c slirc::network::service().
+ *
+ * \note Work posted to the service must hold an
+ *       <tt>io_service::work</tt> for as long as it keeps posting, as the
+ *       pool may be resized and its threads end once they run out of work.
+ *
+ * \see slirc::network::set_handshake_threads()
+ */
+SLIRCAPI boost::asio::io_service *handshake_service();
+
+}
+}
+}
+
+#endif // SLIRC_DETAIL_HANDSHAKE_POOL_HPP_INCLUDED
@@ -0,0 +1,71 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#pragma once
+
+#ifndef SLIRC_DETAIL_RESOLVER_HPP_INCLUDED
+#define SLIRC_DETAIL_RESOLVER_HPP_INCLUDED
+
+#include "system.hpp"
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/system/error_code.hpp>
+
+namespace slirc {
+namespace network {
+namespace detail {
+
+/** \brief Handles the result of a host name lookup.
+ *
+ * Called with the error of the lookup, if any, and the endpoints found, in
+ * the order returned by the system's resolver.
+ */
+typedef std::function<void(
+	const boost::system::error_code &error,
+	const std::vector<boost::asio::ip::tcp::endpoint> &endpoints
+)> resolve_handler;
+
+/** \brief Looks up a host name using the process wide resolver cache.
+ *
+ * Results are cached per host name and port. Concurrent lookups of the same
+ * host name and port are coalesced into one lookup by the system's
+ * resolver.
+ *
+ * \param host The host name to look up.
+ * \param port The port for the endpoints.
+ * \param handler The function to call with the result. It is always called
+ *        from the ASIO service returned by \c slirc::network::service(),
+ *        even if the result was cached.
+ *
+ * \see slirc::network::set_resolver_cache_ttl()
+ */
+SLIRCAPI void resolve(const std::string &host, unsigned port, resolve_handler handler);
+
+}
+}
+}
+
+#endif // SLIRC_DETAIL_RESOLVER_HPP_INCLUDED
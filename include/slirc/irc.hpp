@@ -27,11 +27,16 @@
 
 #include "detail/system.hpp"
 
+#include <cstddef>
+
+#include <atomic>
 #include <map>
 #include <memory>
+#include <stdexcept>
 #include <typeindex>
 #include <typeinfo>
 #include <type_traits>
+#include <vector>
 
 #include <boost/utility.hpp>
 
@@ -60,6 +65,14 @@ class SLIRCAPI irc: public takes_components, private boost::noncopyable {
 	typedef std::map<std::type_index, std::unique_ptr<module_base>> module_container_type;
 	module_container_type modules_;
 	apis::event_manager *event_manager_;
+	apis::event_manager *shared_event_manager_;
+
+	struct module_slot {
+		module_base *module;
+		unsigned long long generation; // changes on every load and unload
+	};
+	typedef std::vector<module_slot> module_slot_container_type;
+	module_slot_container_type module_slots_;
 
 	template<typename Module>
 	static constexpr bool is_valid_module_type() {
@@ -72,13 +85,31 @@ class SLIRCAPI irc: public takes_components, private boost::noncopyable {
 	template<typename Module>
 	inline std::type_index module_index() { return typeid(typename Module::module_base_api_type); }
 
+	// maps each module_base_api_type to a process wide dense slot index
+	static std::size_t module_slot_index(std::type_index);
+
+	template<typename Module>
+	static std::size_t module_slot_index() {
+		static const std::size_t index = module_slot_index(typeid(typename Module::module_base_api_type));
+		return index;
+	}
+
+	inline const module_slot *find_slot_(std::size_t index) const {
+		return (index < module_slots_.size())
+			? &module_slots_[index]
+			: nullptr;
+	}
+
 	// module api backend
-	module_base *find_(std::type_index);
 	void load_(std::type_index, std::unique_ptr<module_base>);
 	bool unload_(std::type_index);
+	void erase_(module_container_type::iterator);
 
 	template<typename Module>
-	inline module_base *find_() { return find_(module_index<Module>()); }
+	inline module_base *find_() {
+		const module_slot *slot = find_slot_(module_slot_index<Module>());
+		return slot ? slot->module : nullptr;
+	}
 
 public:
 	/** \brief Constructs an irc context.
@@ -88,6 +119,39 @@ public:
 	 */
 	irc();
 
+	/** \brief Constructs a lightweight irc context.
+	 *
+	 * A lightweight context does not load an event manager module of its own,
+	 * but uses the given event manager for all of its events instead. This
+	 * allows many contexts to share a single event queue and set of event
+	 * handlers, reducing the construction cost and memory footprint of each
+	 * context to a few hundred bytes.
+	 *
+	 * Events keep track of their context through event::irc, so handlers
+	 * connected to the shared event manager can tell apart which context an
+	 * event belongs to:
+	 * \code
+	 *     slirc::irc host;
+	 *     host.event_manager().connect(some_event, [](slirc::event::pointer e) {
+	 *         handle_for_user(e->irc, e);
+	 *     });
+	 *
+	 *     slirc::irc user_context(host.event_manager());
+	 * \endcode
+	 *
+	 * \param shared_event_manager The event manager to be used by this context.
+	 *
+	 * \note The shared event manager must outlive this context. When the
+	 *       context is destructed, its events still queued in the shared
+	 *       event manager are discarded; events already taken from the queue
+	 *       must not be handled afterwards.
+	 * \note If a module implementing slirc::apis::event_manager is loaded into
+	 *       a lightweight context, it takes precedence over the shared event
+	 *       manager until it is unloaded again. find() and get() will only
+	 *       find such a loaded module, never the shared event manager.
+	 */
+	explicit irc(apis::event_manager &shared_event_manager);
+
 	/** \brief Destructs an irc context.
 	 *
 	 * \note During destruction, all modules are unloaded with the
@@ -189,7 +253,7 @@ public:
 		}
 
 		if (std::is_base_of<apis::event_manager, Module>::value) {
-			event_manager_ = nullptr;
+			event_manager_ = shared_event_manager_;
 		}
 
 		return unload_(module_index<Module>());
@@ -276,6 +340,146 @@ public:
 
 
 
+	/** \brief A cached reference to a module within an irc context.
+	 *
+	 * A handle resolves the module once and afterwards only checks whether
+	 * the module slot has changed since, which is considerably cheaper than
+	 * find() or get(). Use it to access modules from frequently called code,
+	 * e.g. event handlers:
+	 * \code
+	 *     slirc::irc::handle<slirc::apis::connection> connection(irc);
+	 *
+	 *     irc.event_manager().connect(some_event, [connection](slirc::event::pointer) {
+	 *         connection->send_raw("PING :x\r\n");
+	 *     });
+	 * \endcode
+	 *
+	 * Each load or unload of a module changes the generation of its slot. A
+	 * handle notices the change on its next access and resolves the module
+	 * again, so it never refers to an unloaded module.
+	 *
+	 * \tparam Module The type of the module to refer to.
+	 *
+	 * \note A handle must not outlive the irc context it refers to.
+	 * \note Like the rest of the module API, handles must not be used
+	 *       concurrently with loading or unloading modules. One handle may be
+	 *       used by several threads at once, e.g. when captured by an event
+	 *       handler run by several threads handling events.
+	 */
+	template<typename Module>
+	class handle {
+		static_assert(is_valid_module_type<Module>(), "Must be used with a valid module type!");
+
+		::slirc::irc *irc_;
+		std::size_t index_;
+
+		// the cache; threads sharing the handle all store the same result,
+		// the module before the generation it belongs to
+		mutable std::atomic<Module*> module_;
+		mutable std::atomic<unsigned long long> generation_;
+
+		inline Module *resolve(const module_slot *slot) const {
+			Module *mod = slot ? dynamic_cast<Module*>(slot->module) : nullptr;
+			module_.store(mod, std::memory_order_relaxed);
+			generation_.store(slot ? slot->generation : 0, std::memory_order_release);
+			return mod;
+		}
+
+	public:
+		/** \brief Creates a handle for a module within an irc context.
+		 *
+		 * \param irc The IRC context to find the module in.
+		 *
+		 * \note The module does not need to be loaded yet.
+		 */
+		explicit handle(::slirc::irc &irc)
+		: irc_(&irc)
+		, index_(module_slot_index<Module>())
+		, module_(nullptr)
+		, generation_(0) {
+			resolve(irc_->find_slot_(index_));
+		}
+
+		/** \brief Copies a handle.
+		 *
+		 * \param other The handle to copy.
+		 */
+		handle(const handle &other)
+		: irc_(other.irc_)
+		, index_(other.index_)
+		, module_(nullptr)
+		, generation_(0) {
+			*this = other;
+		}
+
+		/** \brief Copies a handle.
+		 *
+		 * \param other The handle to copy.
+		 *
+		 * \return This handle.
+		 */
+		handle &operator=(const handle &other) {
+			// a module newer than the generation only causes another resolve
+			const unsigned long long generation = other.generation_.load(std::memory_order_acquire);
+			irc_ = other.irc_;
+			index_ = other.index_;
+			module_.store(other.module_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			generation_.store(generation, std::memory_order_release);
+			return *this;
+		}
+
+		/** \brief Gets the module.
+		 *
+		 * \return
+		 *     - \c a pointer to the loaded module,
+		 *     - \c nullptr if no module with the same \c module_base_api_type
+		 *          is loaded or the loaded module is not derived from \c Module
+		 */
+		inline Module *get() const {
+			const module_slot *slot = irc_->find_slot_(index_);
+			if ((slot ? slot->generation : 0) != generation_.load(std::memory_order_acquire)) {
+				return resolve(slot);
+			}
+			return module_.load(std::memory_order_relaxed);
+		}
+
+		/** \brief Accesses the module.
+		 *
+		 * \return A reference to the module.
+		 *
+		 * \throw std::range_error if the module is not loaded or not derived
+		 *        from \c Module.
+		 */
+		inline Module &operator*() const {
+			Module *mod = get();
+			if (!mod) throw std::range_error("Requested module not found.");
+			return *mod;
+		}
+
+		/** \brief Accesses the module.
+		 *
+		 * \return A pointer to the module.
+		 *
+		 * \throw std::range_error if the module is not loaded or not derived
+		 *        from \c Module.
+		 */
+		inline Module *operator->() const {
+			return &**this;
+		}
+
+		/** \brief Checks whether the module is available.
+		 *
+		 * \return
+		 *     - \c true if a compatible module is loaded,
+		 *     - \c false otherwise
+		 */
+		explicit inline operator bool() const {
+			return get();
+		}
+	};
+
+
+
 	// event api
 
 	/** \brief Gets the event queue for this IRC context.
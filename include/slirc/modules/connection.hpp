@@ -27,20 +27,32 @@
 
 #include "../detail/system.hpp"
 
+#include <array>
+#include <chrono>
+#include <cstddef>
 #include <memory>
 #include <string>
 
 #include "../component.hpp"
 #include "../apis/connection.hpp"
 
-namespace boost { namespace system {
-	struct error_code;
-}}
+namespace boost {
+	namespace system {
+		struct error_code;
+	}
+	namespace asio { namespace ssl {
+		class context;
+	}}
+}
 
 namespace slirc {
 
 class irc;
 
+namespace network {
+	class transport;
+}
+
 namespace modules {
 
 /** \brief Default implementation for the IRC connection.
@@ -160,11 +172,19 @@ public:
 	 * out by the user to set up other modules for purposes like authentication
 	 * or automatically joining channels).
 	 *
+	 * A Unix domain socket, e.g. of a bouncer on the same host, is specified
+	 * as <tt>"unix://path"</tt>, where everything after \c unix:// is the
+	 * path of the socket and \c port is ignored. A path starting with \c @
+	 * names a socket in the abstract namespace (Linux only). The connection
+	 * behaves the same as over TCP, except that socket options do not apply.
+	 *
 	 * For example (ignored optional parts are left out):
 	 * - <tt>irc://irc.freenode.net</tt>
 	 * - <tt>tcp://irc.freenode.net:8000</tt>
 	 * - <tt>ircs://irc.freenode.net</tt>
 	 * - <tt>ssl://irc.freenode.net:7000</tt>
+	 * - <tt>unix:///run/bouncer/irc.sock</tt>
+	 * - <tt>unix://@bouncer</tt>
 	 *
 	 * The port to be used is determined as follows:
 	 * - If the parameter \c port is not \c 0, it will be used.
@@ -182,6 +202,10 @@ public:
 	 *       take place!
 	 * \note The protocols <tt>ircs</tt> and <tt>ssl</tt> are not available if
 	 *       libslirc was built without SSL support.
+	 * \note The protocol <tt>unix</tt> is not available on platforms without
+	 *       Unix domain sockets.
+	 * \note TLS sessions are remembered per server and port for the lifetime
+	 *       of the process and offered for resumption on later connects.
 	 */
 	void set_endpoint(const std::string &endpoint, unsigned port=0);
 
@@ -201,12 +225,501 @@ public:
 		connect();
 	}
 
+	/** \brief Describes when to reconnect after the connection was lost.
+	 *
+	 * The delay before the n-th consecutive reconnect is
+	 * <tt>initial_delay * multiplier^(n-1)</tt>, limited to \c max_delay,
+	 * and then randomly spread by up to \c jitter in either direction, so
+	 * that many connections lost at once do not reconnect at once.
+	 *
+	 * Reconnects count as consecutive until a session is up: the server
+	 * welcomed the client (numeric \c 001), or the connection stayed
+	 * established for a minute. Connections that are accepted and then
+	 * dropped right away therefore keep backing off.
+	 */
+	struct reconnect_policy {
+		/** \brief Whether to reconnect automatically.
+		 *
+		 * Reconnecting happens whenever the connection is lost or fails to
+		 * be established, but not after a call to \c disconnect().
+		 */
+		bool enabled;
+
+		/// \brief The delay before the first reconnect.
+		std::chrono::milliseconds initial_delay;
+
+		/// \brief The maximum delay before a reconnect.
+		std::chrono::milliseconds max_delay;
+
+		/// \brief The factor the delay grows by with each failed reconnect.
+		double multiplier;
+
+		/// \brief The fraction (\c 0 to \c 1) the delay is spread by.
+		double jitter;
+	};
+
+	/** \brief Sets when to reconnect after the connection was lost.
+	 *
+	 * By default, reconnecting is disabled; the delays default to 1 second
+	 * initially and 5 minutes at most, growing by a factor of 2 and spread
+	 * by 20%.
+	 *
+	 * Reconnecting uses the endpoint currently set. The host name lookup is
+	 * answered from the resolver cache if possible (see
+	 * slirc::network::set_resolver_cache_ttl()).
+	 *
+	 * \param policy The policy to apply.
+	 *
+	 * \note Disabling reconnecting cancels a scheduled reconnect. So do
+	 *       \c connect() and \c disconnect().
+	 */
+	void set_reconnect_policy(const reconnect_policy &policy);
+
+	/** \brief Returns when to reconnect after the connection was lost.
+	 *
+	 * \return The policy currently applied.
+	 */
+	reconnect_policy get_reconnect_policy();
+
+	/** \brief Sets the registration to send on every connect.
+	 *
+	 * The lines are queued as soon as the connection is established, ahead
+	 * of anything sent by handlers of the \c state::connected event, and
+	 * sent in the first write; e.g.
+	 * <tt>"CAP LS 302\r\nNICK me\r\nUSER me 0 * :Me\r\n"</tt>.
+	 *
+	 * \param lines The lines to send, including line breaks. An empty
+	 *        string disables sending a registration, which is the default.
+	 */
+	void set_registration(std::string lines);
+
+	/** \brief Describes options applied to the TCP socket.
+	 */
+	struct socket_options {
+		/** \brief Whether to set \c TCP_NODELAY, i.e. disable Nagle's
+		 *         algorithm.
+		 *
+		 * Lowers the latency of small writes at the cost of more packets.
+		 */
+		bool no_delay;
+
+		/** \brief Whether to set \c TCP_CORK.
+		 *
+		 * The kernel then only sends full packets, or after a timeout.
+		 * Ignored on platforms without \c TCP_CORK.
+		 */
+		bool cork;
+
+		/** \brief The size of the kernel's send buffer (\c SO_SNDBUF).
+		 *
+		 * \c 0 keeps the system default.
+		 */
+		std::size_t send_buffer_size;
+
+		/** \brief Whether to have the kernel encrypt sent data on
+		 *         connections with SSL (kTLS).
+		 *
+		 * This takes the cost of encrypting off the network thread. It is
+		 * only done for TLS 1.3 with AES-GCM or ChaCha20-Poly1305 on Linux
+		 * kernels with kTLS support, and decided once per connection, right
+		 * after the handshake. Otherwise, or if setting it up fails, data
+		 * is encrypted by OpenSSL as usual. Received data is always
+		 * decrypted by OpenSSL.
+		 *
+		 * The secret the kernel needs is taken from OpenSSL's key log
+		 * callback, which is installed on the TLS context the first time
+		 * a connection using it wants kTLS. A key log callback set on the
+		 * context before is still called; one set afterwards disables
+		 * kTLS for that context.
+		 *
+		 * Once the kernel encrypts, OpenSSL never writes to the connection
+		 * again, so it is closed without a TLS close_notify.
+		 *
+		 * \note The kernel cannot follow key updates requested by the
+		 *       server, nor can OpenSSL answer them; such connections fail
+		 *       with an error rather than sending records encrypted twice.
+		 */
+		bool kernel_tls;
+	};
+
+	/** \brief Sets the options applied to the TCP socket.
+	 *
+	 * The options are applied whenever a connection is established, and
+	 * immediately if the connection is currently established. Failing to
+	 * apply an option raises an \c events::error event, but does not close
+	 * the connection.
+	 *
+	 * By default, all options are disabled and the send buffer size is left
+	 * at the system default.
+	 *
+	 * \param options The options to apply.
+	 */
+	void set_socket_options(const socket_options &options);
+
+	/** \brief Returns the options applied to the TCP socket.
+	 *
+	 * \return The options.
+	 */
+	socket_options get_socket_options();
+
+	/** \brief Returns the TLS context used by all connections that were not
+	 *         given one of their own.
+	 *
+	 * The context is created on first use and shared for the lifetime of
+	 * the process, so that each connection only allocates the state of its
+	 * TLS stream. It can be configured, e.g. to load trust stores, but only
+	 * before the first connection uses it, as OpenSSL does not allow
+	 * changing a context that is in use.
+	 *
+	 * \return The process-wide context.
+	 *
+	 * \throw std::logic_error if libslirc was built without SSL support.
+	 */
+	static std::shared_ptr<boost::asio::ssl::context> default_tls_context();
+
+	/** \brief Sets the TLS context to use for endpoints with SSL.
+	 *
+	 * The context can be shared with any number of connections. It is used
+	 * from the next connect on, and is set up to hand out sessions for
+	 * resumption (see set_endpoint()).
+	 *
+	 * \param context The context to use, or \c nullptr to use
+	 *        default_tls_context(), which is the default.
+	 *
+	 * \throw std::logic_error if libslirc was built without SSL support.
+	 */
+	void set_tls_context(std::shared_ptr<boost::asio::ssl::context> context);
+
+	/** \brief Returns the TLS context used for endpoints with SSL.
+	 *
+	 * \return The context set by set_tls_context(), or
+	 *         default_tls_context() if none is set.
+	 *
+	 * \throw std::logic_error if libslirc was built without SSL support.
+	 */
+	std::shared_ptr<boost::asio::ssl::context> get_tls_context();
+
+	/** \brief The priority classes outbound messages are sorted into when
+	 *         flood control is enabled.
+	 *
+	 * Every line is a message of its own and classified by its command,
+	 * also when several lines are passed to a single send call.
+	 */
+	enum class send_priority {
+		/** \brief Sent at once, bypassing flood control.
+		 *
+		 * \c PONG and the registration commands \c PASS, \c NICK,
+		 * \c USER, \c CAP and \c AUTHENTICATE. These still use up
+		 * tokens.
+		 */
+		immediate,
+
+		/** \brief Sent before any bulk messages.
+		 *
+		 * All commands not in one of the other classes, e.g. \c JOIN,
+		 * \c PART, \c MODE or \c QUIT.
+		 */
+		control,
+
+		/** \brief Sent when no control messages are waiting.
+		 *
+		 * \c PRIVMSG and \c NOTICE. Messages to different targets are
+		 * sent in turns, so one target's backlog cannot delay the others.
+		 */
+		bulk
+	};
+
+	/// \brief The number of send priority classes.
+	static constexpr std::size_t send_priorities = 3;
+
+	/** \brief Describes the send rate limits for flood control.
+	 *
+	 * Both limits are token buckets: up to the given amount can be sent at
+	 * once, and the amount is refilled evenly over the course of a window.
+	 * A limit of \c 0 disables that limit; if both are \c 0, flood control
+	 * is disabled, which is the default.
+	 *
+	 * \note With flood control enabled, data is scheduled line by line:
+	 *       data not ending in a line break is held back until the line
+	 *       is completed by subsequent sends. A line longer than the byte
+	 *       limit is sent once the whole limit is available.
+	 */
+	struct flood_control {
+		/// \brief The number of lines that may be sent per window.
+		std::size_t lines_per_window;
+
+		/// \brief The number of bytes that may be sent per window.
+		std::size_t bytes_per_window;
+
+		/// \brief The length of the window.
+		std::chrono::steady_clock::duration window;
+	};
+
+	/** \brief Sets the send rate limits.
+	 *
+	 * Takes effect immediately, also for messages already held back.
+	 *
+	 * \param limits The limits to apply.
+	 */
+	void set_flood_control(const flood_control &limits);
+
+	/** \brief Returns the send rate limits.
+	 *
+	 * \return The limits currently applied.
+	 */
+	flood_control get_flood_control();
+
+	/** \brief Describes the throughput of the connection.
+	 *
+	 * All values refer to the current connection or, if disconnected, to the
+	 * last connection.
+	 */
+	struct statistics {
+		/// \brief The number of completed reads.
+		unsigned long long reads;
+
+		/// \brief The number of bytes received.
+		unsigned long long bytes_in;
+
+		/** \brief The amount of data currently requested per read.
+		 *
+		 * This grows while reads keep filling it, up to 64 KiB, and shrinks
+		 * when the connection is mostly idle.
+		 */
+		std::size_t read_size;
+
+		/// \brief The time the connection has been established for.
+		std::chrono::steady_clock::duration connected_for;
+
+		/** \brief Describes the messages of one send priority class.
+		 */
+		struct send_class {
+			/// \brief The number of messages currently held back.
+			std::size_t queued;
+
+			/// \brief The number of messages sent.
+			unsigned long long sent;
+
+			/// \brief The total time messages were held back.
+			std::chrono::steady_clock::duration total_delay;
+
+			/// \brief The longest time a message was held back.
+			std::chrono::steady_clock::duration max_delay;
+
+			/** \brief The average time a message was held back.
+			 *
+			 * \return The total delay divided by the number of messages
+			 *         sent.
+			 */
+			std::chrono::steady_clock::duration average_delay() const;
+		};
+
+		/** \brief Flood control metrics, indexed by \c send_priority.
+		 *
+		 * Only messages sent while flood control was enabled are counted.
+		 */
+		std::array<send_class, send_priorities> sends;
+
+		/** \brief The number of TLS handshakes completed.
+		 *
+		 * Unlike the other counters, this is not reset on reconnects.
+		 */
+		unsigned long long tls_handshakes;
+
+		/** \brief The number of TLS handshakes that resumed the session of
+		 *         an earlier connection to the same endpoint.
+		 */
+		unsigned long long tls_resumptions;
+
+		/// \brief The time the most recent TLS handshake took.
+		std::chrono::steady_clock::duration last_handshake_time;
+
+		/// \brief Whether the most recent TLS handshake resumed a session.
+		bool last_handshake_resumed;
+
+		/** \brief Whether the kernel encrypts data sent on the connection.
+		 *
+		 * See socket_options::kernel_tls.
+		 */
+		bool kernel_tls;
+
+		/** \brief The average number of reads per second.
+		 *
+		 * \return The number of reads divided by \c connected_for.
+		 */
+		double reads_per_second() const;
+
+		/** \brief The average number of bytes per read.
+		 *
+		 * \return The number of bytes received divided by the number of reads.
+		 */
+		double bytes_per_read() const;
+	};
+
+	/** \brief Describes which events are raised for received lines.
+	 */
+	enum class line_delivery {
+		/** \brief Raise a \c received_line event per line.
+		 *
+		 * This is the default.
+		 *
+		 * The connection queues a single internal event per read, which the
+		 * per-line events are derived from when it is handled. They are
+		 * queued in front of all other events then, so they are handled in
+		 * the order the lines were received.
+		 */
+		lines,
+
+		/** \brief Raise a \c received_lines event per read.
+		 *
+		 * A read scattered across two receive buffers results in two events.
+		 */
+		batches,
+
+		/** \brief Raise both a \c received_lines event per read and a
+		 *         \c received_line event per line.
+		 *
+		 * The per-line events are raised after the batch event.
+		 */
+		lines_and_batches
+	};
+
+	/** \brief Sets which events are raised for received lines.
+	 *
+	 * Takes effect with the next read.
+	 *
+	 * \param delivery The kind of events to raise.
+	 */
+	void set_line_delivery(line_delivery delivery);
+
+	/** \brief Returns which events are raised for received lines.
+	 *
+	 * \return The kind of events raised.
+	 */
+	line_delivery get_line_delivery();
+
+	/** \brief Describes how PINGs from the server are handled.
+	 */
+	enum class keepalive {
+		/** \brief PINGs are delivered like any other line; answering them
+		 *         is left to the event handlers.
+		 *
+		 * This is the default.
+		 */
+		off,
+
+		/** \brief PINGs are answered by the connection as soon as they are
+		 *         received, and no events are raised for them.
+		 *
+		 * The PONG is written from the thread that received the PING, so it
+		 * is not delayed by busy event handlers or a backed up event queue,
+		 * and it is never held back by \c cork(). The command is matched
+		 * case-insensitively.
+		 */
+		answer,
+
+		/** \brief Like \c answer, but the events are still raised, so
+		 *         handlers can observe the PINGs.
+		 *
+		 * Handlers must not answer the PINGs again.
+		 */
+		answer_and_emit
+	};
+
+	/** \brief Sets how PINGs from the server are handled.
+	 *
+	 * Takes effect with the next read.
+	 *
+	 * \param mode How to handle PINGs.
+	 */
+	void set_keepalive(keepalive mode);
+
+	/** \brief Returns how PINGs from the server are handled.
+	 *
+	 * \return How PINGs are handled.
+	 */
+	keepalive get_keepalive();
+
+	/** \brief Starts writing all data received to a capture file.
+	 *
+	 * Every read is recorded with the time since the previous one, so the
+	 * capture can be fed through a connection again with \c replay().
+	 * Capturing continues across reconnects until \c stop_capture() is
+	 * called. An existing file is overwritten.
+	 *
+	 * \param path The path of the capture file.
+	 *
+	 * \throw std::runtime_error if the file cannot be written.
+	 */
+	void start_capture(const std::string &path);
+
+	/** \brief Stops writing received data to the capture file and closes
+	 *         it.
+	 */
+	void stop_capture();
+
+	/** \brief Describes how fast a capture is replayed.
+	 */
+	enum class replay_pacing {
+		/// \brief The reads are replayed as fast as possible.
+		fast,
+
+		/// \brief The reads are replayed with the time between them in the capture.
+		original
+	};
+
+	/** \brief Feeds a capture file through the connection instead of
+	 *         connecting to a server.
+	 *
+	 * The connection becomes connected, the captured data is split into
+	 * lines and raised as events exactly like data read from a server, and
+	 * the connection is disconnected at the end of the capture. Data sent
+	 * in the meantime is dropped. The file is mapped into memory rather
+	 * than read, so large captures are streamed.
+	 *
+	 * \param path The path of a file written by \c start_capture().
+	 * \param pacing How fast the data is replayed.
+	 *
+	 * \throw slirc::exceptions::already_connected if the connection is not
+	 *        currently disconnected.
+	 * \throw std::runtime_error if the file cannot be read or is not a
+	 *        capture.
+	 */
+	void replay(const std::string &path, replay_pacing pacing = replay_pacing::fast);
+
+	/** \brief Uses an already established transport instead of connecting
+	 *         to the endpoint.
+	 *
+	 * The connection becomes connected at once and then behaves exactly as
+	 * if it had connected itself: the registration is sent, the data read is
+	 * split into lines and raised as events and the statistics are kept.
+	 * When the transport ends, the connection is disconnected; as there is
+	 * nothing to connect to again, it is not reconnected. Socket options do
+	 * not apply.
+	 *
+	 * \param transport The transport, e.g. a slirc::network::memory_pipe.
+	 *
+	 * \throw slirc::exceptions::already_connected if the connection is not
+	 *        currently disconnected.
+	 */
+	void connect(std::shared_ptr<network::transport> transport);
+
 	virtual void connect() override;
 	virtual void disconnect() override;
 	virtual state current_state() override;
 
+	/** \brief Returns the current statistics of the connection.
+	 *
+	 * \return A snapshot of the statistics.
+	 */
+	statistics get_statistics();
+
 protected:
+	virtual void do_cork() override;
+	virtual void do_uncork() override;
+	virtual traffic_stats do_get_traffic_stats() override;
 	virtual void do_send_raw(const char *data, std::size_t length) override;
+	virtual void do_send_raw(std::shared_ptr<const char> data, std::size_t length) override;
 };
 
 SLIRC_REGISTER_EVENT_ID_ENUM(connection::events);
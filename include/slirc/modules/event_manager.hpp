@@ -52,6 +52,7 @@ struct SLIRCAPI event_manager: apis::event_manager {
 	virtual event::pointer wait_event() override;
 	virtual event::pointer wait_event(std::chrono::milliseconds timeout) override;
 	virtual void wait_event(event_consumer_type callback) override;
+	virtual void discard_events(const slirc::irc &context) override;
 
 protected:
 	virtual bool connection_less(const disconnector_type &lhs, const disconnector_type &rhs) override;
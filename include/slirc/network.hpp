@@ -27,6 +27,8 @@
 
 #include "detail/system.hpp"
 
+#include <chrono>
+
 namespace boost { namespace asio {
 	struct io_service;
 }}
@@ -80,6 +82,53 @@ SLIRCAPI bool uses_internal_service();
  */
 SLIRCAPI bool has_ssl_support();
 
+/** \brief Sets how long host name lookups are cached.
+ *
+ * Host name lookups by all connections go through a process wide cache.
+ * Successful lookups are cached for \c ttl, failed lookups for
+ * \c negative_ttl. The system's resolver does not report the time to live
+ * of DNS records, so these apply to all host names.
+ *
+ * The defaults are 60 seconds for successful and 5 seconds for failed
+ * lookups. A time of \c 0 disables caching of the respective results;
+ * concurrent lookups of the same host name are coalesced regardless.
+ *
+ * \param ttl The time to cache successful lookups for.
+ * \param negative_ttl The time to cache failed lookups for.
+ *
+ * \note Changed times only apply to lookups finished afterwards.
+ */
+SLIRCAPI void set_resolver_cache_ttl(std::chrono::seconds ttl, std::chrono::seconds negative_ttl);
+
+/** \brief Removes all cached host name lookups.
+ *
+ * Lookups currently running are not affected.
+ */
+SLIRCAPI void clear_resolver_cache();
+
+/** \brief Sets the number of threads running TLS handshakes.
+ *
+ * The cryptography of TLS handshakes is costly. When many connections
+ * reconnect at once, e.g. after a net split, running all their handshakes
+ * on the thread of \c service() stalls the traffic of every established
+ * connection. With a handshake pool, only the handshakes run on the pool's
+ * threads; connections are handed back to \c service() once established.
+ *
+ * The default is \c 0, which runs handshakes on \c service().
+ *
+ * \param threads The number of threads of the pool.
+ *
+ * \note Handshakes already running finish on the threads they were started
+ *       on.
+ */
+SLIRCAPI void set_handshake_threads(unsigned threads);
+
+/** \brief Returns the number of threads running TLS handshakes.
+ *
+ * \return The number of threads set by \c set_handshake_threads().
+ */
+SLIRCAPI unsigned handshake_threads();
+
 }
 }
 
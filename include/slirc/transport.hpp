@@ -0,0 +1,182 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#pragma once
+
+#ifndef SLIRC_TRANSPORT_HPP_INCLUDED
+#define SLIRC_TRANSPORT_HPP_INCLUDED
+
+#include "detail/system.hpp"
+
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/asio/buffer.hpp>
+#include <boost/system/error_code.hpp>
+
+#include "util/noncopyable.hpp"
+
+namespace slirc {
+namespace network {
+
+/** \brief The byte stream a connection to an IRC server runs on.
+ *
+ * slirc::modules::connection reads from and writes to its server through
+ * this interface, so the way the bytes travel is independent of how they
+ * are buffered and split into lines. libslirc provides transports for TCP,
+ * SSL/TLS and Unix domain sockets, which are set up when connecting to an
+ * endpoint, and \c memory_pipe.
+ *
+ * \note The connection calls all functions with its internal lock held.
+ *       Completion handlers lock it, too, so they must never be called from
+ *       within these functions; posting them to \c slirc::network::service()
+ *       is the usual way to call them.
+ */
+class SLIRCAPI transport: util::noncopyable {
+public:
+	/** \brief Is called when an operation completed.
+	 *
+	 * \param error The error that occurred, if any.
+	 * \param bytes_transferred The number of bytes read or written.
+	 */
+	typedef std::function<void(const boost::system::error_code &error, std::size_t bytes_transferred)> handler;
+
+	/// \brief The buffers a read is scattered across; the second may be empty.
+	typedef std::array<boost::asio::mutable_buffer, 2> read_buffers;
+
+	/// \brief The buffers a write is gathered from.
+	typedef std::vector<boost::asio::const_buffer> write_buffers;
+
+	virtual ~transport() {}
+
+	/** \brief Starts reading some data.
+	 *
+	 * \param buffers The buffers to read into. They stay valid until the
+	 *        handler is called.
+	 * \param handler Is called once, when at least one byte was read, the
+	 *        end of the stream was reached (\c boost::asio::error::eof) or
+	 *        reading failed.
+	 */
+	virtual void async_read_some(const read_buffers &buffers, handler handler) = 0;
+
+	/** \brief Starts writing all of the given data.
+	 *
+	 * \param buffers The data to write. The data the buffers refer to stays
+	 *        valid until the handler is called.
+	 * \param handler Is called once, when all data was written or writing
+	 *        failed.
+	 */
+	virtual void async_write(const write_buffers &buffers, handler handler) = 0;
+
+	/** \brief Closes the transport.
+	 *
+	 * Pending operations complete with
+	 * \c boost::asio::error::operation_aborted.
+	 */
+	virtual void close() = 0;
+};
+
+/** \brief A transport within the process, fed by the application.
+ *
+ * Data passed to \c feed() is copied straight into the buffers of a pending
+ * read, whose handler then runs on the feeding thread, so the connection
+ * splits it into lines and raises the events before \c feed() returns. This
+ * allows benchmarking and testing the connection without any sockets.
+ *
+ * \code
+ * auto pipe = std::make_shared<slirc::network::memory_pipe>();
+ * connection.connect(pipe);
+ * pipe->feed(":server 001 me :Welcome\r\n");
+ * \endcode
+ */
+class SLIRCAPI memory_pipe: public transport, public std::enable_shared_from_this<memory_pipe> {
+public:
+	/** \brief Receives the data written by the connection.
+	 *
+	 * Is called with the connection's lock held, so it must not call into
+	 * the connection.
+	 */
+	typedef std::function<void(const char *data, std::size_t length)> sink;
+
+	/** \brief Creates a pipe.
+	 *
+	 * \param written Receives the data the connection writes; if empty,
+	 *        the data is discarded.
+	 */
+	explicit memory_pipe(sink written = sink());
+
+	/** \brief Delivers data to the connection.
+	 *
+	 * If the connection is waiting for data, the data is handled on the
+	 * calling thread before this function returns. Otherwise, it is kept
+	 * until the connection reads again.
+	 *
+	 * \param data The data.
+	 * \param length The length of the data.
+	 *
+	 * \note Must not be called with the lock of the connection held, i.e.
+	 *       from the sink or from within the connection.
+	 */
+	void feed(const char *data, std::size_t length);
+
+	/** \brief Delivers data to the connection.
+	 *
+	 * \param data The data.
+	 *
+	 * \see feed(const char *, std::size_t)
+	 */
+	void feed(const std::string &data) {
+		feed(data.data(), data.size());
+	}
+
+	/** \brief Ends the stream once all data fed has been read.
+	 *
+	 * The connection then disconnects.
+	 */
+	void end();
+
+	virtual void async_read_some(const read_buffers &buffers, handler handler) override;
+	virtual void async_write(const write_buffers &buffers, handler handler) override;
+	virtual void close() override;
+
+private:
+	// moves as much buffered data as fits into the buffers
+	std::size_t take_buffered(const read_buffers &buffers);
+
+	std::mutex mutex;
+	sink written;
+	std::string buffered;  // fed while no read was pending
+	read_buffers reading;  // of the pending read
+	handler read_handler;  // of the pending read, if any
+	bool ended;
+	bool closed;
+};
+
+}
+}
+
+#endif // SLIRC_TRANSPORT_HPP_INCLUDED
@@ -0,0 +1,100 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#pragma once
+
+#ifndef SLIRC_UTIL_LINE_SCANNER_HPP_INCLUDED
+#define SLIRC_UTIL_LINE_SCANNER_HPP_INCLUDED
+
+#include "../detail/system.hpp"
+
+#include <cstddef>
+#include <vector>
+
+namespace slirc {
+namespace util {
+
+/** \brief Describes the position of a line within a buffer.
+ */
+struct line_span {
+	std::size_t begin;  ///< The offset of the first character of the line.
+	std::size_t length; ///< The length of the line, excluding the line break.
+};
+
+/** \brief Splits a buffer into lines.
+ *
+ * Finds all complete lines, i.e. lines terminated by <tt>'\\n'</tt>, within
+ * a buffer. A <tt>'\\r'</tt> directly preceding the <tt>'\\n'</tt> is not
+ * considered part of the line.
+ *
+ * Line breaks are searched using SIMD instructions (AVX2 or SSE2) where the
+ * CPU supports them. The implementation is selected once at runtime.
+ *
+ * \param data The buffer to be split.
+ * \param size The size of the buffer.
+ * \param lines The vector to append the lines found to. Its contents are not
+ *        cleared, so its capacity can be reused across calls.
+ * \param scan_from The offset to start searching for line breaks at. Must
+ *        not be greater than \c size. The first line still begins at offset
+ *        0; use this to skip the part of a partial line that is known not
+ *        to contain a line break.
+ *
+ * \return The offset directly after the last line break, i.e. the begin of
+ *         the incomplete line at the end of the buffer, or \c 0 if no line
+ *         break was found.
+ */
+SLIRCAPI std::size_t index_lines(
+	const char *data, std::size_t size,
+	std::vector<line_span> &lines,
+	std::size_t scan_from = 0);
+
+/** \brief Returns the name of the implementation used by index_lines().
+ *
+ * \return One of <tt>"avx2"</tt>, <tt>"sse2"</tt> or <tt>"scalar"</tt>.
+ */
+SLIRCAPI const char *index_lines_implementation();
+
+namespace detail {
+	/** \brief An implementation of index_lines().
+	 *
+	 * Exposed so that every implementation can be tested, not just the one
+	 * selected for the CPU in use.
+	 */
+	struct index_lines_implementation {
+		/// \brief The name of the implementation, as returned by util::index_lines_implementation().
+		const char *name;
+
+		/// \brief The implementation itself, taking the same arguments as util::index_lines().
+		std::size_t (*function)(const char *, std::size_t, std::vector<line_span> &, std::size_t);
+	};
+
+	/** \brief Lists the implementations of index_lines() the CPU in use supports.
+	 *
+	 * \return The supported implementations, the scalar one always included.
+	 */
+	SLIRCAPI std::vector<index_lines_implementation> supported_index_lines_implementations();
+}
+
+}
+}
+
+#endif // SLIRC_UTIL_LINE_SCANNER_HPP_INCLUDED
@@ -0,0 +1,140 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#pragma once
+
+#ifndef SLIRC_UTIL_MPSC_QUEUE_HPP_INCLUDED
+#define SLIRC_UTIL_MPSC_QUEUE_HPP_INCLUDED
+
+#include "../detail/system.hpp"
+
+#include <atomic>
+#include <memory>
+#include <utility>
+
+#include "noncopyable.hpp"
+
+namespace slirc {
+namespace util {
+
+/** \brief A lock-free queue for multiple producers and a single consumer.
+ *
+ * Producers push single elements using an atomic compare-and-swap; they
+ * never block each other or the consumer. The consumer takes all elements
+ * pushed so far at once.
+ *
+ * \tparam T The type of the elements.
+ *
+ * \note \c push() and \c empty() may be called from any thread at any time.
+ *       Calls to \c consume_all() must not overlap each other.
+ */
+template<typename T>
+class mpsc_queue: noncopyable {
+	struct node {
+		node *next;
+		T value;
+	};
+
+	std::atomic<node*> head_; // most recently pushed element
+
+public:
+	/** \brief Constructs an empty queue.
+	 */
+	mpsc_queue()
+	: head_(nullptr) {}
+
+	/** \brief Destroys the queue and all elements still in it.
+	 */
+	~mpsc_queue() {
+		node *current = head_.load();
+		while(current) {
+			node *next = current->next;
+			delete current;
+			current = next;
+		}
+	}
+
+	/** \brief Adds an element to the end of the queue.
+	 *
+	 * \param value The element to add.
+	 */
+	void push(T value) {
+		node *added = new node{ nullptr, std::move(value) };
+		added->next = head_.load();
+		while(!head_.compare_exchange_weak(added->next, added)) {}
+	}
+
+	/** \brief Checks whether the queue is empty.
+	 *
+	 * \return \c true if no elements are in the queue, \c false otherwise.
+	 */
+	bool empty() const {
+		return !head_.load();
+	}
+
+	/** \brief Removes all elements from the queue.
+	 *
+	 * \param consumer A function to be called with each removed element, as
+	 *        an rvalue, in the order the elements were pushed in.
+	 *
+	 * \return The number of elements removed.
+	 *
+	 * \note If \c consumer throws, the remaining elements removed from the
+	 *       queue are destroyed without being passed to it.
+	 */
+	template<typename Consumer>
+	std::size_t consume_all(Consumer &&consumer) {
+		// the elements are linked newest first; reverse them
+		node *oldest = nullptr;
+		node *current = head_.exchange(nullptr);
+		while(current) {
+			node *next = current->next;
+			current->next = oldest;
+			oldest = current;
+			current = next;
+		}
+
+		std::size_t count = 0;
+		try {
+			while(oldest) {
+				std::unique_ptr<node> consumed(oldest);
+				oldest = oldest->next;
+				++count;
+				consumer(std::move(consumed->value));
+			}
+		}
+		catch(...) {
+			while(oldest) {
+				node *next = oldest->next;
+				delete oldest;
+				oldest = next;
+			}
+			throw;
+		}
+		return count;
+	}
+};
+
+}
+}
+
+#endif // SLIRC_UTIL_MPSC_QUEUE_HPP_INCLUDED
@@ -0,0 +1,55 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#pragma once
+
+#ifndef SLIRC_UTIL_STRING_VIEW_HPP_INCLUDED
+#define SLIRC_UTIL_STRING_VIEW_HPP_INCLUDED
+
+#include "../detail/system.hpp"
+
+#if __has_include(<string_view>)
+#	include <string_view>
+#elif __has_include(<experimental/string_view>)
+#	include <experimental/string_view>
+#else
+#	error Neither std::string_view nor std::experimental::string_view are supported
+#endif
+
+namespace slirc {
+namespace util {
+
+/** \brief A non-owning view into a string.
+ *
+ * Refers to std::string_view or std::experimental::string_view, depending on
+ * which is available.
+ */
+#if __has_include(<string_view>)
+using std::string_view;
+#elif __has_include(<experimental/string_view>)
+using std::experimental::string_view;
+#endif
+
+}
+}
+
+#endif // SLIRC_UTIL_STRING_VIEW_HPP_INCLUDED
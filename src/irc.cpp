@@ -23,12 +23,35 @@
 #include "../include/slirc/irc.hpp"
 #include "../include/slirc/modules/event_manager.hpp"
 
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+	struct module_slot_registry {
+		std::mutex mutex;
+		/* ^ */ std::unordered_map<std::type_index, std::size_t> indices;
+	};
+
+	module_slot_registry &get_module_slot_registry() {
+		static module_slot_registry registry;
+		return registry;
+	}
+}
+
 slirc::irc::irc()
 : modules_()
-, event_manager_(nullptr) {
+, event_manager_(nullptr)
+, shared_event_manager_(nullptr)
+, module_slots_() {
 	load<modules::event_manager>();
 }
 
+slirc::irc::irc(apis::event_manager &shared_event_manager)
+: modules_()
+, event_manager_(&shared_event_manager)
+, shared_event_manager_(&shared_event_manager)
+, module_slots_() {}
+
 slirc::irc::~irc() {
 	// TODO: Possibly do multiple passes and let modules order their own
 	//       unload order?
@@ -38,32 +61,46 @@ slirc::irc::~irc() {
 				++begin;
 			}
 			else {
-				begin = modules_.erase(begin);
+				erase_(begin++);
 			}
 		}
 	}
 
 	{ auto begin=modules_.begin();
 		while(begin != modules_.end()) {
-			begin = modules_.erase(begin);
+			erase_(begin++);
 		}
 	}
+
+	if (shared_event_manager_) {
+		// the queue outlives this context, but its events refer to it
+		shared_event_manager_->discard_events(*this);
+	}
 }
 
-slirc::module_base *slirc::irc::find_(std::type_index ti) {
-	auto it = modules_.find(ti);
-	return (it == modules_.end())
-		? nullptr
-		: it->second.get();
+std::size_t slirc::irc::module_slot_index(std::type_index ti) {
+	module_slot_registry &registry = get_module_slot_registry();
+
+	std::unique_lock<std::mutex> lock(registry.mutex);
+	return registry.indices.emplace(ti, registry.indices.size()).first->second;
 }
 
 void slirc::irc::load_(std::type_index ti, std::unique_ptr<module_base> module) {
 	SLIRC_ASSERT( module && "Must not attempt to load 'no module'" );
 
+	const std::size_t index = module_slot_index(ti);
+	if (module_slots_.size() <= index) {
+		module_slots_.resize(index+1, module_slot{ nullptr, 0 });
+	}
+
 	std::unique_ptr<module_base> &curmodule = modules_[ti];
 	SLIRC_ASSERT( !curmodule && "Must not replace an already loaded module!" );
 
 	curmodule = std::move(module);
+
+	module_slot &slot = module_slots_[index];
+	slot.module = curmodule.get();
+	++slot.generation;
 }
 
 bool slirc::irc::unload_(std::type_index ti) {
@@ -73,6 +110,16 @@ bool slirc::irc::unload_(std::type_index ti) {
 		return false;
 	}
 
-	modules_.erase(it);
+	erase_(it);
 	return true;
 }
+
+void slirc::irc::erase_(module_container_type::iterator it) {
+	// detach the slot first, so the module is no longer found while it is
+	// being destructed
+	module_slot &slot = module_slots_[module_slot_index(it->first)];
+	slot.module = nullptr;
+	++slot.generation;
+
+	modules_.erase(it);
+}
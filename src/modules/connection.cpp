@@ -22,11 +22,22 @@
 
 #include "../../include/slirc/modules/connection.hpp"
 
+#include <cctype>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
 #include <mutex>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
 #if __has_include(<optional>)
@@ -42,15 +53,41 @@ using std::experimental::nullopt;
 #endif
 
 #include <boost/asio/buffer.hpp>
+#include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/version.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #ifndef SLIRC_BUILD_NO_SSL
 #	include <boost/asio/ssl/context.hpp>
 #	include <boost/asio/ssl/stream.hpp>
+#	include <openssl/ssl.h>
+#	if defined(__linux__) && __has_include(<linux/tls.h>)
+#		define SLIRC_HAVE_KTLS
+#		include <netinet/tcp.h>
+#		include <sys/socket.h>
+#		include <linux/tls.h>
+#		include <openssl/kdf.h>
+#		ifndef SOL_TLS
+#			define SOL_TLS 282
+#		endif
+#		ifndef TCP_ULP
+#			define TCP_ULP 31
+#		endif
+#	endif
 #endif
 
 #include "../../include/slirc/exceptions.hpp"
 #include "../../include/slirc/irc.hpp"
 #include "../../include/slirc/network.hpp"
+#include "../../include/slirc/transport.hpp"
+#include "../../include/slirc/detail/handshake_pool.hpp"
+#include "../../include/slirc/detail/resolver.hpp"
+#include "../../include/slirc/util/line_scanner.hpp"
+#include "../../include/slirc/util/mpsc_queue.hpp"
 
 #undef IF_SSL
 #ifdef SLIRC_BUILD_NO_SSL
@@ -67,7 +104,678 @@ using tcp_socket =
 			asio::ip::tcp
 		>
 	>;
-using tcp_resolver = asio::ip::tcp::resolver;
+#ifdef TCP_CORK
+using tcp_cork = asio::detail::socket_option::boolean<IPPROTO_TCP, TCP_CORK>;
+#endif
+
+#ifndef SLIRC_BUILD_NO_SSL
+// members of connection::impl, so they must not be in an anonymous namespace
+namespace slirc { namespace modules { namespace detail {
+	// the transport of TLS streams: a TCP socket whose completions can be
+	// moved to the handshake pool, as asio does the cryptography of a TLS
+	// handshake in the completions of the transport's operations
+	class tls_transport {
+		template<typename Handler>
+		struct hop {
+			void operator()(const boost::system::error_code &error, std::size_t bytes_transferred) {
+				if (!pool) {
+					handler(error, bytes_transferred);
+				}
+				else {
+					Handler moved(std::move(handler));
+					pool->post([moved, error, bytes_transferred]() mutable {
+						moved(error, bytes_transferred);
+					});
+				}
+			}
+
+			Handler handler;
+			asio::io_service *pool;
+		};
+
+	public:
+		typedef asio::ip::tcp::socket next_layer_type;
+		typedef next_layer_type::lowest_layer_type lowest_layer_type;
+
+		explicit tls_transport(asio::io_service &service)
+		: socket(service)
+		, pool(nullptr)
+		, pool_work()
+		, sealed(false)
+		, refused(false) {}
+
+#if BOOST_ASIO_VERSION >= 101100
+		typedef next_layer_type::executor_type executor_type;
+
+		executor_type get_executor() {
+			return socket.get_executor();
+		}
+#else
+		asio::io_service &get_io_service() {
+			return socket.get_io_service();
+		}
+#endif
+
+		next_layer_type &next_layer() {
+			return socket;
+		}
+
+		lowest_layer_type &lowest_layer() {
+			return socket.lowest_layer();
+		}
+
+		const lowest_layer_type &lowest_layer() const {
+			return socket.lowest_layer();
+		}
+
+		// completions of operations started from now on run on pool, or
+		// where they completed if pool is nullptr
+		void complete_on(asio::io_service *pool_) {
+			pool = pool_;
+			if (pool) {
+				pool_work.emplace(*pool);
+			}
+			else {
+				pool_work = nullopt;
+			}
+		}
+
+		template<typename MutableBufferSequence, typename Handler>
+		void async_read_some(const MutableBufferSequence &buffers, Handler handler) {
+			socket.async_read_some(buffers, hop<Handler>{ std::move(handler), pool });
+		}
+
+		// once the kernel encrypts sent data (kTLS), records from OpenSSL
+		// must not reach the socket any more, as they would be encrypted
+		// twice; writing them fails instead
+		void seal_output() {
+			sealed = true;
+		}
+
+		// whether OpenSSL had something to send after seal_output()
+		bool output_refused() const {
+			return refused;
+		}
+
+		template<typename ConstBufferSequence, typename Handler>
+		void async_write_some(const ConstBufferSequence &buffers, Handler handler) {
+			if (sealed) {
+				refused = true;
+				hop<Handler> refuse{ std::move(handler), pool };
+				slirc::network::service().post([refuse]() mutable {
+					refuse(boost::system::errc::make_error_code(boost::system::errc::operation_not_permitted), 0);
+				});
+				return;
+			}
+			socket.async_write_some(buffers, hop<Handler>{ std::move(handler), pool });
+		}
+
+		template<typename MutableBufferSequence>
+		std::size_t read_some(const MutableBufferSequence &buffers, boost::system::error_code &ec) {
+			return socket.read_some(buffers, ec);
+		}
+
+		template<typename ConstBufferSequence>
+		std::size_t write_some(const ConstBufferSequence &buffers, boost::system::error_code &ec) {
+			if (sealed) {
+				refused = true;
+				ec = boost::system::errc::make_error_code(boost::system::errc::operation_not_permitted);
+				return 0;
+			}
+			return socket.write_some(buffers, ec);
+		}
+
+	private:
+		next_layer_type socket;
+		asio::io_service *pool;
+		optional<asio::io_service::work> pool_work; // the pool must not run dry meanwhile
+		bool sealed;  // sent data is encrypted by the kernel
+		bool refused; // OpenSSL tried to write nonetheless
+	};
+
+	// a TLS 1.3 traffic secret; kept in place, so no copies of it are left
+	// behind in freed memory
+	struct traffic_secret {
+		unsigned char bytes[EVP_MAX_MD_SIZE];
+		std::size_t size;
+	};
+
+	// the part of a connection's TLS state that OpenSSL callbacks work on
+	struct tls_state {
+		tls_state()
+		: want_traffic_secret(false)
+		, client_traffic_secret() {}
+
+		~tls_state() {
+			forget_traffic_secret();
+		}
+
+		void forget_traffic_secret() {
+			OPENSSL_cleanse(client_traffic_secret.bytes, sizeof(client_traffic_secret.bytes));
+			client_traffic_secret.size = 0;
+		}
+
+		std::string session_key;  // "host:port"
+		bool want_traffic_secret; // for kTLS
+		traffic_secret client_traffic_secret;
+	};
+}}}
+
+using slirc::modules::detail::tls_transport;
+using slirc::modules::detail::tls_state;
+using slirc::modules::detail::traffic_secret;
+
+namespace {
+	// TLS sessions of earlier connections by "host:port"; they are offered
+	// again on reconnects, so servers can resume them instead of doing a
+	// full handshake
+	class tls_session_cache {
+		struct session_free {
+			void operator()(SSL_SESSION *session) const {
+				SSL_SESSION_free(session);
+			}
+		};
+
+	public:
+		typedef std::unique_ptr<SSL_SESSION, session_free> session_ptr;
+
+		static tls_session_cache &instance() {
+			static tls_session_cache cache;
+			return cache;
+		}
+
+		// sessions are copied in and out, as OpenSSL marks the session of a
+		// connection closed without a TLS shutdown as not resumable
+		void store(const std::string &key, const SSL_SESSION *session) {
+			session_ptr copy(SSL_SESSION_dup(session));
+			if (!copy) {
+				return;
+			}
+			std::unique_lock<std::mutex> lock(mutex);
+			sessions[key].swap(copy);
+		}
+
+		// returns nullptr if none is cached
+		session_ptr find(const std::string &key) {
+			std::unique_lock<std::mutex> lock(mutex);
+			auto it = sessions.find(key);
+			if (it == sessions.end()) {
+				return nullptr;
+			}
+			return session_ptr(SSL_SESSION_dup(it->second.get()));
+		}
+
+		void forget(const std::string &key) {
+			session_ptr removed;
+			std::unique_lock<std::mutex> lock(mutex);
+			auto it = sessions.find(key);
+			if (it != sessions.end()) {
+				removed.swap(it->second);
+				sessions.erase(it);
+			}
+		}
+
+	private:
+		std::mutex mutex;
+		std::unordered_map<std::string, session_ptr> sessions;
+	};
+
+	// where SSL objects refer to their tls_state; the app data slot is taken
+	// by asio
+	int tls_state_index() {
+		static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+		return index;
+	}
+
+	tls_state *get_tls_state(const SSL *native) {
+		return static_cast<tls_state *>(SSL_get_ex_data(native, tls_state_index()));
+	}
+
+	// called by OpenSSL whenever the server hands out a session (with TLS 1.3
+	// this happens after the handshake, while reading)
+	int store_new_session(SSL *native, SSL_SESSION *session) {
+		const tls_state *state = get_tls_state(native);
+		if (!state) {
+			return 0; // not set up for caching
+		}
+		tls_session_cache::instance().store(state->session_key, session);
+		return 0; // stored a copy; OpenSSL keeps its reference
+	}
+
+	typedef void (*keylog_callback)(const SSL *, const char *);
+
+	// the key log callback a context had before capture_traffic_secret()
+	// was installed, so it keeps being called
+	struct chained_keylog {
+		std::atomic<keylog_callback> previous;
+	};
+
+	int chained_keylog_index() {
+		static const int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr,
+			[](void *, void *chained, CRYPTO_EX_DATA *, int, long, void *) {
+				delete static_cast<chained_keylog *>(chained);
+			});
+		return index;
+	}
+
+	int hex_digit(char c) {
+		if ('0' <= c && c <= '9') return c - '0';
+		if ('a' <= c && c <= 'f') return c - 'a' + 10;
+		if ('A' <= c && c <= 'F') return c - 'A' + 10;
+		return -1;
+	}
+
+	// called by OpenSSL with each secret of a handshake, as a line of the NSS
+	// key log format; only the secret for data sent by the client is kept,
+	// and only by connections wanting kTLS
+	void capture_traffic_secret(const SSL *native, const char *line) {
+		static const char label[] = "CLIENT_TRAFFIC_SECRET_0 ";
+		tls_state *state = get_tls_state(native);
+		const char *hex = (state && state->want_traffic_secret && !std::strncmp(line, label, sizeof(label)-1))
+			? std::strchr(line + sizeof(label)-1, ' ') // skip client random
+			: nullptr;
+		if (hex) {
+			// decoded straight into place
+			traffic_secret &secret = state->client_traffic_secret;
+			state->forget_traffic_secret();
+			for(++hex; secret.size < sizeof(secret.bytes); hex += 2) {
+				const int high = hex_digit(hex[0]), low = (0 <= high) ? hex_digit(hex[1]) : -1;
+				if (low < 0) break;
+				secret.bytes[secret.size++] = static_cast<unsigned char>(high << 4 | low);
+			}
+		}
+
+		const auto *chained = static_cast<const chained_keylog *>(
+			SSL_CTX_get_ex_data(SSL_get_SSL_CTX(native), chained_keylog_index()));
+		if (chained) {
+			if (const keylog_callback previous = chained->previous.load()) {
+				previous(native, line);
+			}
+		}
+	}
+
+	// lets the connections of a context capture their traffic secret;
+	// only done once a connection wants kTLS, and a key log callback set
+	// by the user is still called
+	void capture_traffic_secrets(SSL_CTX *context) {
+		static std::mutex mutex;
+		std::unique_lock<std::mutex> lock(mutex);
+
+		const keylog_callback current = SSL_CTX_get_keylog_callback(context);
+		if (current == &capture_traffic_secret) {
+			return;
+		}
+		auto *chained = static_cast<chained_keylog *>(SSL_CTX_get_ex_data(context, chained_keylog_index()));
+		if (!chained) {
+			// kept until the context is freed, as handshakes may be using it
+			chained = new chained_keylog();
+			SSL_CTX_set_ex_data(context, chained_keylog_index(), chained);
+		}
+		chained->previous = current;
+		SSL_CTX_set_keylog_callback(context, &capture_traffic_secret);
+	}
+
+	// sets up a context to hand sessions to tls_session_cache (rather than
+	// keeping them itself, as contexts are shared between endpoints)
+	void prepare_tls_context(asio::ssl::context &context) {
+		SSL_CTX_set_session_cache_mode(context.native_handle(),
+			SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+		SSL_CTX_sess_set_new_cb(context.native_handle(), &store_new_session);
+	}
+
+#ifdef SLIRC_HAVE_KTLS
+	// HKDF-Expand-Label of TLS 1.3 (RFC 8446, section 7.1) with an empty
+	// context
+	bool expand_label(
+		const EVP_MD *md, const traffic_secret &secret,
+		const std::string &label, unsigned char *out, std::size_t length
+	) {
+		const std::string full_label = "tls13 " + label;
+		std::vector<unsigned char> info;
+		info.push_back(static_cast<unsigned char>(length >> 8));
+		info.push_back(static_cast<unsigned char>(length));
+		info.push_back(static_cast<unsigned char>(full_label.size()));
+		info.insert(info.end(), full_label.begin(), full_label.end());
+		info.push_back(0);
+
+		EVP_PKEY_CTX *kdf = EVP_PKEY_CTX_new_id(EVP_PKEY_HKDF, nullptr);
+		const bool ok = kdf
+			&& EVP_PKEY_derive_init(kdf) > 0
+			&& EVP_PKEY_CTX_hkdf_mode(kdf, EVP_PKEY_HKDEF_MODE_EXPAND_ONLY) > 0
+			&& EVP_PKEY_CTX_set_hkdf_md(kdf, md) > 0
+			&& EVP_PKEY_CTX_set1_hkdf_key(kdf, secret.bytes, static_cast<int>(secret.size)) > 0
+			&& EVP_PKEY_CTX_add1_hkdf_info(kdf, info.data(), static_cast<int>(info.size())) > 0
+			&& EVP_PKEY_derive(kdf, out, &length) > 0;
+		EVP_PKEY_CTX_free(kdf);
+		return ok;
+	}
+
+	template<typename CryptoInfo>
+	bool install_kernel_tls_tx(
+		int fd, unsigned short cipher_type, const EVP_MD *md,
+		const traffic_secret &secret
+	) {
+		CryptoInfo info;
+		std::memset(&info, 0, sizeof(info));
+		info.info.version = TLS_1_3_VERSION;
+		info.info.cipher_type = cipher_type;
+
+		// the kernel wants the write IV split into salt and the rest; the
+		// record sequence number is 0
+		unsigned char iv[sizeof(info.salt) + sizeof(info.iv)];
+		bool ok = expand_label(md, secret, "key", info.key, sizeof(info.key))
+			&& expand_label(md, secret, "iv", iv, sizeof(iv));
+		if (ok) {
+			std::memcpy(info.salt, iv, sizeof(info.salt));
+			std::memcpy(info.iv, iv + sizeof(info.salt), sizeof(info.iv));
+			ok = setsockopt(fd, SOL_TCP, TCP_ULP, "tls", sizeof("tls")) == 0
+				&& setsockopt(fd, SOL_TLS, TLS_TX, &info, sizeof(info)) == 0;
+		}
+
+		OPENSSL_cleanse(&info, sizeof(info));
+		OPENSSL_cleanse(iv, sizeof(iv));
+		return ok;
+	}
+
+	// hands encryption of sent data to the kernel; must be called right
+	// after the handshake, before any data has been sent. Only TLS 1.3 is
+	// supported, as the secrets of earlier versions are not at hand.
+	bool enable_kernel_tls_tx(SSL *native, int fd, const traffic_secret &secret) {
+		if (SSL_version(native) != TLS1_3_VERSION || !secret.size) {
+			return false;
+		}
+
+		switch(SSL_CIPHER_get_protocol_id(SSL_get_current_cipher(native))) {
+			case 0x1301: // TLS_AES_128_GCM_SHA256
+				return install_kernel_tls_tx<tls12_crypto_info_aes_gcm_128>(
+					fd, TLS_CIPHER_AES_GCM_128, EVP_sha256(), secret);
+#	ifdef TLS_CIPHER_AES_GCM_256
+			case 0x1302: // TLS_AES_256_GCM_SHA384
+				return install_kernel_tls_tx<tls12_crypto_info_aes_gcm_256>(
+					fd, TLS_CIPHER_AES_GCM_256, EVP_sha384(), secret);
+#	endif
+#	ifdef TLS_CIPHER_CHACHA20_POLY1305
+			case 0x1303: // TLS_CHACHA20_POLY1305_SHA256
+				return install_kernel_tls_tx<tls12_crypto_info_chacha20_poly1305>(
+					fd, TLS_CIPHER_CHACHA20_POLY1305, EVP_sha256(), secret);
+#	endif
+			default:
+				return false;
+		}
+	}
+#endif
+}
+#endif
+
+namespace {
+	// Captures of received data are a header followed by one record per
+	// read: the microseconds since the previous record (or the start of
+	// the capture) and the number of bytes, both as LEB128 varints, and
+	// the bytes themselves.
+	namespace capture_format {
+		constexpr char magic[] = { 'S', 'L', 'I', 'R', 'C', 'C', 'A', 'P', 1 };
+
+		inline bool put_varint(std::FILE *file, unsigned long long value) {
+			unsigned char bytes[10];
+			std::size_t length = 0;
+			do {
+				bytes[length] = value & 0x7f;
+				value >>= 7;
+				if (value) bytes[length] |= 0x80;
+				++length;
+			} while(value);
+			return length == std::fwrite(bytes, 1, length, file);
+		}
+
+		// returns nullptr if the varint is truncated
+		inline const char *get_varint(const char *pos, const char *end, unsigned long long &value) {
+			value = 0;
+			for(unsigned shift = 0; pos < end && shift < 64; shift += 7) {
+				const unsigned char byte = *pos++;
+				value |= static_cast<unsigned long long>(byte & 0x7f) << shift;
+				if (!(byte & 0x80)) return pos;
+			}
+			return nullptr;
+		}
+	}
+
+	// the transport on a connected stream socket: TCP, or a Unix domain
+	// socket
+	template<typename Socket>
+	class socket_transport: public slirc::network::transport {
+	public:
+		explicit socket_transport(Socket &&connected)
+		: socket(std::move(connected)) {}
+
+		Socket &next_layer() {
+			return socket;
+		}
+
+		virtual void async_read_some(const read_buffers &buffers, handler handler) override {
+			socket.async_read_some(buffers, std::move(handler));
+		}
+
+		virtual void async_write(const write_buffers &buffers, handler handler) override {
+			asio::async_write(socket, buffers, std::move(handler));
+		}
+
+		virtual void close() override {
+			boost::system::error_code ec;
+			socket.shutdown(Socket::shutdown_both, ec); // ignore error code
+			socket.close(ec); // ignore error code
+		}
+
+	private:
+		Socket socket;
+	};
+
+	typedef socket_transport<asio::ip::tcp::socket> tcp_transport;
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+	typedef socket_transport<asio::local::stream_protocol::socket> local_transport;
+#endif
+
+#ifndef SLIRC_BUILD_NO_SSL
+	// the transport on an established TLS stream; the stream stays owned by
+	// the connection, which keeps the state of the SSL object with it
+	class ssl_stream_transport: public slirc::network::transport {
+	public:
+		ssl_stream_transport(asio::ssl::stream<tls_transport> &stream, bool kernel_tx)
+		: stream(stream)
+		, kernel_tx(kernel_tx) {}
+
+		virtual void async_read_some(const read_buffers &buffers, handler handler) override {
+			stream.async_read_some(buffers, std::move(handler));
+		}
+
+		virtual void async_write(const write_buffers &buffers, handler handler) override {
+			if (kernel_tx) {
+				// the kernel encrypts, bypassing OpenSSL
+				asio::async_write(stream.next_layer().next_layer(), buffers, std::move(handler));
+			}
+			else {
+				asio::async_write(stream, buffers, std::move(handler));
+			}
+		}
+
+		virtual void close() override {
+			// no TLS shutdown; with kernel_tx, OpenSSL must not write at all
+			boost::system::error_code ec;
+			stream.lowest_layer().shutdown(asio::ip::tcp::socket::shutdown_both, ec); // ignore error code
+			stream.lowest_layer().close(ec); // ignore error code
+		}
+
+	private:
+		asio::ssl::stream<tls_transport> &stream;
+		const bool kernel_tx;
+	};
+#endif
+
+	// the transport reading a capture file (see connection::replay());
+	// written data is dropped
+	class replay_transport: public slirc::network::transport, public std::enable_shared_from_this<replay_transport> {
+	public:
+		typedef std::chrono::steady_clock clock;
+
+		// throws boost::interprocess::interprocess_exception if the file
+		// cannot be mapped
+		replay_transport(const std::string &path, slirc::modules::connection::replay_pacing pacing)
+		: file(path.c_str(), boost::interprocess::read_only)
+		, region(file, boost::interprocess::read_only)
+		, pos(static_cast<const char *>(region.get_address()))
+		, end(pos + region.get_size())
+		, record(pos)
+		, record_end(pos)
+		, pacing(pacing)
+		, started(clock::now())
+		, offset(clock::duration::zero())
+		, timer(slirc::network::service())
+		, closed(false) {}
+
+		bool is_capture() {
+			if (static_cast<std::size_t>(end - pos) < sizeof(capture_format::magic)
+				|| std::memcmp(pos, capture_format::magic, sizeof(capture_format::magic))
+			) {
+				return false;
+			}
+			pos += sizeof(capture_format::magic);
+			return true;
+		}
+
+		virtual void async_read_some(const read_buffers &buffers, handler handler) override {
+			boost::system::error_code error;
+			while(!closed && record == record_end) {
+				if (pos == end) {
+					error = asio::error::eof;
+					break;
+				}
+
+				unsigned long long delay, length;
+				const char *data = capture_format::get_varint(pos, end, delay);
+				data = data ? capture_format::get_varint(data, end, length) : nullptr;
+				if (!data || static_cast<unsigned long long>(end - data) < length) {
+					error = boost::system::errc::make_error_code(boost::system::errc::bad_message);
+					break;
+				}
+				record = data;
+				record_end = pos = data + length;
+				offset += std::chrono::duration_cast<clock::duration>(std::chrono::microseconds(delay));
+
+				if (pacing == slirc::modules::connection::replay_pacing::original && clock::now() < started + offset) {
+					timer.expires_at(started + offset);
+					timer.async_wait([self=shared_from_this(), buffers, handler](const boost::system::error_code &error) {
+						if (error) {
+							handler(asio::error::operation_aborted, 0);
+						}
+						else {
+							handler(error, self->take(buffers));
+						}
+					});
+					return;
+				}
+			}
+			if (closed) {
+				error = asio::error::operation_aborted;
+			}
+
+			const std::size_t bytes_transferred = error ? 0 : take(buffers);
+			slirc::network::service().post([handler, error, bytes_transferred]{
+				handler(error, bytes_transferred);
+			});
+		}
+
+		virtual void async_write(const write_buffers &buffers, handler handler) override {
+			const std::size_t bytes_transferred = asio::buffer_size(buffers);
+			slirc::network::service().post([handler, bytes_transferred]{
+				handler(boost::system::error_code(), bytes_transferred);
+			});
+		}
+
+		virtual void close() override {
+			closed = true;
+			timer.cancel();
+		}
+
+	private:
+		// copies as much of the current record as fits into the buffers
+		std::size_t take(const read_buffers &buffers) {
+			std::size_t taken = 0;
+			for(const auto &buffer : buffers) {
+				const std::size_t part = std::min<std::size_t>(asio::buffer_size(buffer), record_end - record);
+				std::memcpy(asio::buffer_cast<char*>(buffer), record, part);
+				record += part;
+				taken += part;
+			}
+			return taken;
+		}
+
+		boost::interprocess::file_mapping file;
+		boost::interprocess::mapped_region region;
+		const char *pos; // the next record
+		const char *const end;
+		const char *record; // the rest of the current record
+		const char *record_end;
+		const slirc::modules::connection::replay_pacing pacing;
+		const clock::time_point started;
+		clock::duration offset; // of the current record in the capture
+		asio::steady_timer timer; // paces the records
+		bool closed;
+	};
+}
+
+namespace slirc { namespace modules { namespace detail {
+	// A batch of lines to be raised as received_line events. The events
+	// are derived from the batch only when it is handled, so a read costs
+	// the receiving thread a single event no matter how many lines it has.
+	enum connection_events : event::underlying_id_type {
+		derive_received_line_events
+	};
+	SLIRC_REGISTER_EVENT_ID_ENUM(connection_events);
+} } }
+using slirc::modules::detail::derive_received_line_events;
+
+namespace {
+	// The handlers deriving received_line events, one per event manager
+	// rather than per connection: lightweight contexts share the event
+	// manager, and every handler would otherwise see every batch of all of
+	// them. They are counted by the connections using them.
+	class line_event_derivations {
+	public:
+		static line_event_derivations &instance() {
+			static line_event_derivations derivations;
+			return derivations;
+		}
+
+		void add(slirc::apis::event_manager &manager, void (*derive)(slirc::event::pointer)) {
+			std::unique_lock<std::mutex> lock(mutex);
+			derivation &d = derivations[&manager];
+			if (!d.users++) {
+				d.handler = manager.connect(derive_received_line_events, derive, slirc::apis::event_manager::last);
+			}
+		}
+
+		void remove(slirc::apis::event_manager &manager) {
+			std::unique_lock<std::mutex> lock(mutex);
+			auto it = derivations.find(&manager);
+			if (it != derivations.end() && !--it->second.users) {
+				it->second.handler.disconnect();
+				derivations.erase(it);
+			}
+		}
+
+	private:
+		struct derivation {
+			derivation()
+			: handler()
+			, users(0) {}
+
+			slirc::apis::event_manager::connection handler;
+			std::size_t users;
+		};
+
+		std::mutex mutex;
+		std::unordered_map<slirc::apis::event_manager*, derivation> derivations;
+	};
+}
 
 
 
@@ -98,138 +806,1051 @@ struct slirc::modules::connection::impl: std::enable_shared_from_this<impl> {
 
 #ifndef SLIRC_BUILD_NO_SSL
 	struct ssl_impl {
-		ssl_impl(asio::io_service &service)
-		: context(asio::ssl::context::sslv23_client)
-		, socket(service, context) {}
-
-		asio::ssl::context context;
-		asio::ssl::stream<asio::ip::tcp::socket> socket;
+		ssl_impl(asio::io_service &service, std::shared_ptr<asio::ssl::context> context_)
+		: context(std::move(context_))
+		, socket(service, *context)
+		, kernel_tx(false) {}
+
+		std::shared_ptr<asio::ssl::context> context; // shared between connections
+		asio::ssl::stream<tls_transport> socket;
+		tls_state state; // referenced by the SSL object
+		bool kernel_tx;  // sent data is encrypted by the kernel
 	};
 #endif
 
 	slirc::modules::connection &module;
 	std::mutex mutex;
-		std::string hostname;
+		std::string hostname; // or the path of a Unix domain socket
 		unsigned port;
+		bool local; // connecting to a Unix domain socket
 		state curstate;
-		optional<tcp_resolver> resolver;
-		tcp_resolver::iterator resolve_iterator;
-		optional<asio::ip::tcp::socket> socket;
+		std::atomic<asio::io_service*> send_service; // where producers post kicks to
+		optional<asio::steady_timer> flood_timer;
+		connection::socket_options sockopts;
+		std::shared_ptr<const std::string> registration; // sent first on every connect
+		struct reconnect_ {
+			connection::reconnect_policy policy;
+			optional<asio::steady_timer> timer;
+			unsigned attempt; // reconnects since the last session that counted as up
+			bool pending;     // a reconnect is scheduled
+			bool welcomed;    // the server sent RPL_WELCOME in the current session
+			std::chrono::steady_clock::time_point connected_at;
+			std::minstd_rand random;
+		} reconnect;
+		connection::line_delivery delivery;
+		apis::event_manager *line_derivations; // whose handler derives received_line events from batches
+		connection::keepalive pings;
+		unsigned long long resolve_round; // tells apart lookups of earlier connects
+		struct connect_race_ {
+			// connection attempts to the resolved endpoints are started
+			// staggered and run concurrently; the first one to succeed wins
+			std::vector<asio::ip::tcp::endpoint> endpoints; // in the order to try them
+			std::size_t next;                               // the next endpoint to try
+			std::vector<std::shared_ptr<asio::ip::tcp::socket>> attempts; // still running
+			optional<asio::steady_timer> timer;             // staggers the attempts
+			unsigned long long round;                       // tells apart handlers of earlier races
+		} race;
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+		std::shared_ptr<asio::local::stream_protocol::socket> local_attempt; // still running
+#endif
+		std::shared_ptr<network::transport> transport; // while connected
+		tcp_socket *transport_socket; // under the transport, if connected by us
+		bool attached; // the transport was handed in rather than connected
+		struct capture_ {
+			// received data is appended to file while set
+			std::unique_ptr<std::FILE, int(*)(std::FILE*)> file;
+			std::chrono::steady_clock::time_point last_record;
+		} capture;
 #ifndef SLIRC_BUILD_NO_SSL
 		optional<ssl_impl> ssl;
+		std::shared_ptr<asio::ssl::context> tls_context; // nullptr: the default one
 #endif
 		struct buffers_ {
-			typedef std::vector<char> buffer;
-			typedef std::array<char, 640> raw_buffer;
+			typedef std::vector<char> slab;
+
+			// received data is read directly into slabs; complete lines are
+			// handed out as views sharing ownership of the slab
+			static constexpr slab::size_type slab_size = 8192;
+
+			// the amount of data requested per read adapts between these:
+			// it grows while reads keep filling it and shrinks when they
+			// come back mostly empty
+			static constexpr slab::size_type min_read_size = 512;
+			static constexpr slab::size_type max_read_size = 65536;
+
+			// replaced slabs kept for reuse
+			static constexpr std::size_t max_spare_slabs = 4;
+
+			// a part of the outbound data: either a buffer owned by the caller
+			// or, if no owner is set, a copy of the data
+			struct send_chunk {
+				std::shared_ptr<const char> owner;
+				std::string copy;
+				std::size_t length;
+
+				const char *data() const {
+					return owner ? owner.get() : copy.data();
+				}
+			};
+
+			// with flood control enabled, outbound data is held back here
+			// line by line, sorted by priority and (for bulk messages) by
+			// target, until the token buckets allow sending it
+			struct send_scheduler {
+				typedef std::chrono::steady_clock clock;
+				typedef connection::send_priority priority;
+
+				// a single line, possibly sent in several chunks
+				struct message {
+					std::vector<send_chunk> chunks;
+					std::size_t bytes;
+					clock::time_point queued_at;
+				};
+
+				struct bucket {
+					bucket()
+					: capacity(0)
+					, tokens(0)
+					, per_second(0) {}
+
+					void configure(std::size_t per_window, clock::duration window) {
+						const double seconds = std::chrono::duration<double>(window).count();
+						capacity = (0 < seconds) ? per_window : 0;
+						tokens = capacity;
+						per_second = (0 < seconds) ? per_window / seconds : 0;
+					}
+
+					bool limited() const {
+						return 0 < capacity;
+					}
+
+					void refill(double seconds) {
+						tokens = std::min(capacity, tokens + seconds * per_second);
+					}
+
+					// a line larger than the whole bucket is sent once it is
+					// full; the debt it leaves delays the following lines
+					double missing(std::size_t cost) const {
+						return limited()
+							? std::max(0.0, std::min<double>(cost, capacity) - tokens)
+							: 0.0;
+					}
+
+					double seconds_until(std::size_t cost) const {
+						return limited() ? missing(cost) / per_second : 0.0;
+					}
+
+					void take(std::size_t cost) {
+						if (limited()) tokens -= cost;
+					}
+
+					double capacity;
+					double tokens;
+					double per_second;
+				};
+
+				send_scheduler()
+				: limits{ 0, 0, clock::duration::zero() }
+				, lines()
+				, bytes()
+				, refilled_at(clock::now())
+				, building()
+				, queues()
+				, bulk_targets()
+				, bulk_turns()
+				, classes() {}
+
+				void configure(const connection::flood_control &new_limits) {
+					limits = new_limits;
+					lines.configure(limits.lines_per_window, limits.window);
+					bytes.configure(limits.bytes_per_window, limits.window);
+					refilled_at = clock::now();
+				}
+
+				bool limited() const {
+					return lines.limited() || bytes.limited();
+				}
+
+				bool pending() const {
+					for(const auto &cls : classes) {
+						if (cls.queued) return true;
+					}
+					return false;
+				}
+
+				// whether outbound data has to pass through the scheduler
+				bool active() const {
+					return limited() || pending() || !building.chunks.empty();
+				}
+
+				void push(send_chunk &&chunk, clock::time_point now) {
+					// every line is classified, charged and queued on its own,
+					// so the lines following the first one of a chunk cannot
+					// share its class or slip past the buckets with it
+					const char *const line_break = static_cast<const char*>(
+						std::memchr(chunk.data(), '\n', chunk.length));
+					if (!line_break) {
+						building.chunks.push_back(std::move(chunk));
+						return; // wait for the rest of the line
+					}
+					if (line_break + 1 == chunk.data() + chunk.length) {
+						building.chunks.push_back(std::move(chunk));
+						queue_line(now);
+						return;
+					}
+
+					// several lines: the parts share the chunk's data
+					std::shared_ptr<const char> owner = std::move(chunk.owner);
+					if (!owner) {
+						const auto copy = std::make_shared<std::string>(std::move(chunk.copy));
+						owner = std::shared_ptr<const char>(copy, copy->data());
+					}
+					const char *begin = owner.get();
+					const char *const end = begin + chunk.length;
+					while(begin < end) {
+						const char *const next_break = static_cast<const char*>(
+							std::memchr(begin, '\n', end - begin));
+						const char *const part_end = next_break ? next_break + 1 : end;
+						building.chunks.push_back(send_chunk{
+							std::shared_ptr<const char>(owner, begin), std::string(), std::size_t(part_end - begin) });
+						if (next_break) {
+							queue_line(now);
+						}
+						begin = part_end;
+					}
+				}
+
+				// moves the completed line in building to its queue
+				void queue_line(clock::time_point now) {
+					building.bytes = 0;
+					for(const auto &part : building.chunks) {
+						building.bytes += part.length;
+					}
+					building.queued_at = now;
+
+					std::string target;
+					const priority cls = (building.chunks.size() == 1)
+						? classify(building.chunks.front().data(), building.bytes, target)
+						: classify(joined(building), target); // rare: a line sent in pieces
+					++classes[static_cast<std::size_t>(cls)].queued;
+
+					if (cls == priority::bulk) {
+						auto &target_queue = bulk_targets[target];
+						if (target_queue.empty()) {
+							bulk_turns.push_back(target);
+						}
+						target_queue.push_back(std::move(building));
+					}
+					else {
+						queues[static_cast<std::size_t>(cls)].push_back(std::move(building));
+					}
+					building = message();
+				}
+
+				// moves the messages that may be sent now into out; returns the
+				// time until the next message may be sent, if any is left
+				clock::duration take(std::vector<send_chunk> &out, clock::time_point now) {
+					lines.refill(std::chrono::duration<double>(now - refilled_at).count());
+					bytes.refill(std::chrono::duration<double>(now - refilled_at).count());
+					refilled_at = now;
+
+					while(true) {
+						priority cls;
+						message *next = peek(cls);
+						if (!next) return clock::duration::zero();
+
+						if (cls != priority::immediate && (lines.missing(1) || bytes.missing(next->bytes))) {
+							const double wait = std::max(lines.seconds_until(1), bytes.seconds_until(next->bytes));
+							return std::max<clock::duration>(
+								std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(wait)),
+								std::chrono::milliseconds(1));
+						}
+
+						lines.take(1);
+						bytes.take(next->bytes);
+
+						auto &stats = classes[static_cast<std::size_t>(cls)];
+						const auto delay = now - next->queued_at;
+						--stats.queued;
+						++stats.sent;
+						stats.total_delay += delay;
+						stats.max_delay = std::max(stats.max_delay, delay);
+
+						for(auto &chunk : next->chunks) {
+							out.push_back(std::move(chunk));
+						}
+						pop(cls);
+					}
+				}
+
+				// returns the number of bytes dropped
+				std::size_t clear() {
+					std::size_t dropped = 0;
+					for(const auto &chunk : building.chunks) {
+						dropped += chunk.length;
+					}
+					for(const auto &queue : queues) {
+						for(const auto &msg : queue) {
+							dropped += msg.bytes;
+						}
+					}
+					for(const auto &target_queue : bulk_targets) {
+						for(const auto &msg : target_queue.second) {
+							dropped += msg.bytes;
+						}
+					}
+
+					building = message();
+					for(auto &queue : queues) {
+						queue.clear();
+					}
+					bulk_targets.clear();
+					bulk_turns.clear();
+					for(auto &cls : classes) {
+						cls.queued = 0;
+					}
+					return dropped;
+				}
+
+				void reset_statistics() {
+					for(auto &cls : classes) {
+						cls = connection::statistics::send_class{ cls.queued, 0,
+							clock::duration::zero(), clock::duration::zero() };
+					}
+				}
+
+				connection::flood_control limits;
+				bucket lines;
+				bucket bytes;
+				clock::time_point refilled_at;
+				message building; // the message not yet completed by a line break
+				std::array<std::deque<message>, connection::send_priorities> queues; // bulk unused
+				std::unordered_map<std::string, std::deque<message>> bulk_targets;
+				std::deque<std::string> bulk_turns; // targets with bulk messages, in turn
+				std::array<connection::statistics::send_class, connection::send_priorities> classes;
+
+			private:
+				message *peek(priority &cls) {
+					for(auto c : { priority::immediate, priority::control }) {
+						auto &queue = queues[static_cast<std::size_t>(c)];
+						if (!queue.empty()) {
+							cls = c;
+							return &queue.front();
+						}
+					}
+					if (!bulk_turns.empty()) {
+						cls = priority::bulk;
+						return &bulk_targets[bulk_turns.front()].front();
+					}
+					return nullptr;
+				}
+
+				void pop(priority cls) {
+					if (cls != priority::bulk) {
+						queues[static_cast<std::size_t>(cls)].pop_front();
+						return;
+					}
+
+					// the target had its turn; queue it again if it has more
+					const std::string target = std::move(bulk_turns.front());
+					bulk_turns.pop_front();
+					const auto target_queue = bulk_targets.find(target);
+					target_queue->second.pop_front();
+					if (target_queue->second.empty()) {
+						bulk_targets.erase(target_queue);
+					}
+					else {
+						bulk_turns.push_back(target);
+					}
+				}
+
+				static std::string joined(const message &msg) {
+					std::string line;
+					line.reserve(msg.bytes);
+					for(const auto &part : msg.chunks) {
+						line.append(part.data(), part.length);
+					}
+					return line;
+				}
+
+				static priority classify(const std::string &line, std::string &target) {
+					return classify(line.data(), line.size(), target);
+				}
+
+				static priority classify(const char *line, std::size_t length, std::string &target) {
+					const char *pos = line;
+					const char *const end = pos + length;
+
+					const auto is_space = [](char c) { return c == ' ' || c == '\r' || c == '\n'; };
+					const auto next_word = [&] {
+						while(pos < end && *pos == ' ') ++pos;
+						const char *const begin = pos;
+						while(pos < end && !is_space(*pos)) ++pos;
+						return std::string(begin, pos);
+					};
+
+					std::string command = next_word();
+					if (!command.empty() && command[0] == ':') {
+						command = next_word(); // skip prefix
+					}
+					for(auto &c : command) {
+						if ('a' <= c && c <= 'z') c += 'A' - 'a';
+					}
+
+					if (command == "PRIVMSG" || command == "NOTICE") {
+						target = next_word();
+						for(auto &c : target) {
+							if ('A' <= c && c <= 'Z') c += 'a' - 'A';
+						}
+						return priority::bulk;
+					}
+					if (command == "PONG" || command == "PASS" || command == "NICK"
+						|| command == "USER" || command == "CAP" || command == "AUTHENTICATE") {
+						return priority::immediate;
+					}
+					return priority::control;
+				}
+			};
 
 			buffers_(impl &impl_)
 			: imp(impl_)
-			, send_buffer()
-			, fill_buffer()
-			, recv_buffer()
-			, raw_recv_buffer(std::make_shared<raw_buffer>())
-			, current_send_state(send_buffer.end())
+			, recv_slab(std::make_shared<slab>(slab_size))
+			, recv_spill_slab()
+			, spare_slabs()
+			, recv_begin(0)
+			, recv_scan(0)
+			, recv_end(0)
+			, recv_read_size(min_read_size)
+			, recv_buffers()
+			, recv_lines()
+			, send_queue()
+			, send_scheduled(false)
+			, corked_threads(0)
+			, cork_mutex()
+			, cork_stages()
+			, sessions(0)
+			, send_in_flight()
+			, send_gather()
+			, scheduler()
 			, send_job_running(false) {}
 
+			// Outbound data is pushed into send_queue by any thread without
+			// locking the mutex. The first producer to find no send job
+			// scheduled posts a kick to the io service, which takes over the
+			// queue under the mutex and keeps writing until it is empty.
+			//
+			// Corking only affects the thread doing it: its data is staged
+			// until it uncorks, while other threads (including the one
+			// answering PINGs) keep sending as usual.
+
+			// the data sent by a thread while it has the connection corked
+			struct cork_stage {
+				unsigned depth;
+				unsigned long long session; // when corked first
+				std::vector<send_chunk> chunks;
+			};
+
 			void append(const char *data, std::size_t length) {
+				// can be called from any thread; mutex need not be locked
+				if (0 == length) return;
+
+				imp.traffic.record_queued(length);
+				enqueue(send_chunk{ nullptr, std::string(data, length), length });
+			}
+
+			void append(std::shared_ptr<const char> data, std::size_t length) {
+				// can be called from any thread; mutex need not be locked
+				if (0 == length) return;
+
+				imp.traffic.record_queued(length);
+				enqueue(send_chunk{ std::move(data), std::string(), length });
+			}
+
+			void cork() {
+				// can be called from any thread; mutex need not be locked
+				std::unique_lock<std::mutex> lock(cork_mutex);
+				cork_stage &stage = cork_stages[std::this_thread::get_id()];
+				if (0 == stage.depth++) {
+					stage.session = sessions.load();
+					++corked_threads;
+				}
+			}
+
+			void uncork() {
+				// can be called from any thread; mutex need not be locked
+				std::vector<send_chunk> staged;
+				bool same_session;
+				{ std::unique_lock<std::mutex> lock(cork_mutex);
+					const auto stage = cork_stages.find(std::this_thread::get_id());
+					SLIRC_ASSERT( stage != cork_stages.end() && "uncork() called more often than cork()" );
+					if (stage == cork_stages.end() || --stage->second.depth) {
+						return;
+					}
+					staged = std::move(stage->second.chunks);
+					same_session = stage->second.session == sessions.load();
+					cork_stages.erase(stage);
+					--corked_threads;
+				}
+
+				if (!same_session) {
+					// the connection the data was meant for has ended
+					std::size_t dropped = 0;
+					for(const auto &chunk : staged) {
+						dropped += chunk.length;
+					}
+					imp.traffic.record_dequeued(dropped);
+					return;
+				}
+				for(auto &chunk : staged) {
+					send_queue.push(std::move(chunk));
+				}
+				kick();
+			}
+
+			void push_unstaged(std::shared_ptr<const char> data, std::size_t length) {
+				// assumes mutex to be locked!
+				// bypasses corks; sent by the next send_pushed()
+				imp.traffic.record_queued(length);
+				send_queue.push(send_chunk{ std::move(data), std::string(), length });
+			}
+
+			void send_pushed() {
 				// assumes mutex to be locked, and the connection to be established!
-				buffer::size_type prev_size = fill_buffer.size();
-				fill_buffer.resize(prev_size + length);
-				std::copy(data, data+length, fill_buffer.begin()+prev_size);
+				if (!send_scheduled.exchange(true)) {
+					send(); // neither a send job running nor a kick posted
+				}
+				// otherwise the running send job or the posted kick takes it
+			}
+
+			void enqueue(send_chunk &&chunk) {
+				// can be called from any thread; mutex need not be locked
+				if (corked_threads.load(std::memory_order_relaxed)) {
+					// the calling thread sees its own cork in any case
+					std::unique_lock<std::mutex> lock(cork_mutex);
+					const auto stage = cork_stages.find(std::this_thread::get_id());
+					if (stage != cork_stages.end()) {
+						stage->second.chunks.push_back(std::move(chunk));
+						return;
+					}
+				}
+				send_queue.push(std::move(chunk));
+				kick();
+			}
+
+			void kick() {
+				// can be called from any thread; mutex need not be locked
+				if (send_scheduled.exchange(true)) {
+					return; // already taken care of
+				}
+
+				asio::io_service *service = imp.send_service.load();
+				if (!service) {
+					// never connected; the data is dropped on connecting
+					send_scheduled = false;
+					return;
+				}
 
-				if (!send_job_running && 0 < length) {
-					send_job_running = true;
+				service->post([self = weak_impl(imp.shared_from_this())]{
+					locked_impl impl_ = self.lock();
+					if (!impl_) return; // implementation has been destroyed
+
+					std::unique_lock<std::mutex> lock(impl_->mutex);
+					impl_->buffers.kicked();
+				});
+			}
+
+			void kicked() {
+				// assumes mutex to be locked!
+				if (imp.curstate != state::connected) {
+					// only sent while connected
+					std::size_t dropped = 0;
+					send_queue.consume_all([&](send_chunk &&chunk) { dropped += chunk.length; });
+					imp.traffic.record_dequeued(dropped);
+					send_scheduled = false;
+				}
+				else if (!send_job_running) {
 					send();
 				}
+				// otherwise the running send job picks up the queued data
 			}
 
 			void clear() {
-				send_buffer.clear();
-				fill_buffer.clear();
-				recv_buffer.clear();
+				// assumes mutex to be locked!
+				++sessions; // data still staged by corked threads is dropped
+				std::size_t dropped = 0;
+				send_queue.consume_all([&](send_chunk &&chunk) { dropped += chunk.length; });
+				send_scheduled = false;
+				for(const auto &chunk : send_in_flight) {
+					dropped += chunk.length;
+				}
+				send_in_flight.clear();
+				send_gather.clear();
+				dropped += scheduler.clear();
+				imp.traffic.record_dequeued(dropped);
+				recv_begin = recv_scan = recv_end = 0;
+				imp.traffic.receive_buffered.store(0, std::memory_order_relaxed);
+				if (!sole_owner(recv_slab)) {
+					// still referenced by received lines or a pending read
+					retire_slab(std::move(recv_slab));
+					recv_slab = take_slab(slab_size);
+				}
+				retire_slab(std::move(recv_spill_slab));
+				recv_read_size = min_read_size;
 				send_job_running = false;
 			}
 
-			void swap() {
+			void prepare_recv() {
 				// assumes mutex to be locked!
-				std::swap(send_buffer, fill_buffer);
-				current_send_state = send_buffer.begin();
-				fill_buffer.clear();
+				if (min_read_size > recv_slab->size() - recv_end) {
+					// move the pending partial line to the front; lines handed
+					// out as views must never be overwritten, so the slab can
+					// only be reused in place if no line refers to it any more,
+					// which is rare, as the lines of the last read are usually
+					// still queued; otherwise a spare slab is used
+					const slab::size_type pending = recv_end - recv_begin;
+					const slab::size_type new_size = std::max(slab_size, pending + recv_read_size);
+
+					if (sole_owner(recv_slab) && pending + min_read_size <= recv_slab->size()) {
+						std::copy(
+							recv_slab->begin() + recv_begin, recv_slab->begin() + recv_end,
+							recv_slab->begin()
+						);
+					}
+					else {
+						std::shared_ptr<slab> fresh_slab = take_slab(new_size);
+						std::copy(
+							recv_slab->begin() + recv_begin, recv_slab->begin() + recv_end,
+							fresh_slab->begin()
+						);
+						retire_slab(std::move(recv_slab));
+						recv_slab = std::move(fresh_slab);
+					}
+
+					recv_scan -= recv_begin;
+					recv_end = pending;
+					recv_begin = 0;
+				}
+
+				// never read more than recv_read_size, so it really limits
+				// the amount of data requested from the transport
+				const slab::size_type tail = recv_slab->size() - recv_end;
+				recv_buffers[0] = asio::mutable_buffer(recv_slab->data() + recv_end, std::min(tail, recv_read_size));
+
+				retire_slab(std::move(recv_spill_slab)); // not spilled into
+				if (recv_read_size <= tail) {
+					recv_buffers[1] = asio::mutable_buffer();
+				}
+				else {
+					// scatter the read across the rest of this slab and a spill
+					// slab; the spill slab leaves enough room at its front to
+					// move the partial line at the end of this slab in front
+					// of the data read into it
+					const slab::size_type headroom = recv_slab->size() - recv_begin;
+					recv_spill_slab = take_slab(headroom + recv_read_size - tail);
+					recv_buffers[1] = asio::mutable_buffer(
+						recv_spill_slab->data() + headroom,
+						recv_read_size - tail // a reused spare slab may be larger
+					);
+				}
+			}
+
+			static bool sole_owner(const std::shared_ptr<slab> &s) {
+				if (s.use_count() != 1) {
+					return false;
+				}
+				// pairs with the release of the last other reference, so the
+				// slab is not written to before the last reader is done
+				std::atomic_thread_fence(std::memory_order_acquire);
+				return true;
+			}
+
+			std::shared_ptr<slab> take_slab(slab::size_type size) {
+				// assumes mutex to be locked!
+				for(auto it = spare_slabs.begin(); it != spare_slabs.end(); ++it) {
+					if (size <= (*it)->size() && sole_owner(*it)) {
+						std::shared_ptr<slab> reused = std::move(*it);
+						spare_slabs.erase(it);
+						return reused;
+					}
+				}
+				return std::make_shared<slab>(size);
+			}
+
+			void retire_slab(std::shared_ptr<slab> retired) {
+				// assumes mutex to be locked!
+				if (retired && spare_slabs.size() < max_spare_slabs) {
+					spare_slabs.push_back(std::move(retired));
+				}
+			}
+
+			template<typename LineHandler>
+			void complete_recv(std::size_t bytes_transferred, LineHandler &&emit_lines) {
+				// assumes mutex to be locked!
+				const std::size_t first_size = asio::buffer_size(recv_buffers[0]);
+
+				// adapt the size of the next read
+				if (recv_read_size <= bytes_transferred) {
+					recv_read_size = std::min(max_read_size, 2*recv_read_size);
+				}
+				else if (bytes_transferred < recv_read_size/4) {
+					recv_read_size = std::max(min_read_size, recv_read_size/2);
+				}
+
+				if (bytes_transferred <= first_size) {
+					recv_end += bytes_transferred;
+					emit_lines();
+					return;
+				}
+
+				// data was scattered into the spill slab: handle all lines in
+				// this slab, then move the remaining partial line in front of
+				// the spilled data and continue on the spill slab
+				recv_end += first_size;
+				emit_lines();
+
+				const slab::size_type headroom = recv_slab->size() - recv_begin;
+				const slab::size_type spilled_begin = asio::buffer_cast<char*>(recv_buffers[1]) - recv_spill_slab->data();
+				SLIRC_ASSERT( headroom <= spilled_begin && "spill slab has too little headroom for the partial line" );
+
+				std::copy(
+					recv_slab->begin() + recv_begin, recv_slab->end(),
+					recv_spill_slab->begin() + (spilled_begin - headroom)
+				);
+
+				retire_slab(std::move(recv_slab));
+				recv_slab = std::move(recv_spill_slab);
+				recv_begin = spilled_begin - headroom;
+				recv_scan = spilled_begin; // partial line is known not to contain a line break
+				recv_end = spilled_begin + (bytes_transferred - first_size);
+				emit_lines();
 			}
 
 			void send() {
 				// assumes mutex to be locked, and the connection to be established!
-				if (send_buffer.end() == current_send_state) {
-					swap();
-				}
-				if (send_buffer.end() == current_send_state) {
+				while(true) {
+					const auto now = send_scheduler::clock::now();
+					send_queue.consume_all([&](send_chunk &&chunk) {
+						if (scheduler.active()) {
+							scheduler.push(std::move(chunk), now);
+						}
+						else {
+							send_in_flight.push_back(std::move(chunk));
+						}
+					});
+
+					const auto wait = scheduler.take(send_in_flight, now);
+					if (!send_in_flight.empty()) break;
+
+					if (scheduler.pending()) {
+						imp.wait_for_flood_control(wait);
+					}
+
 					send_job_running = false;
-					return;
+					send_scheduled = false;
+
+					// data pushed before send_scheduled was reset did not post
+					// a kick; take care of it unless another kick was posted
+					if (send_queue.empty() || send_scheduled.exchange(true)) {
+						return;
+					}
+				}
+				send_job_running = true;
+
+				send_gather.clear();
+				for(const auto &chunk : send_in_flight) {
+					send_gather.push_back(asio::const_buffer(chunk.data(), chunk.length));
+					imp.traffic.record_write(chunk.data(), chunk.length);
 				}
+				traffic_::add(imp.traffic.writes, 1);
 
 				const auto &send_callback =
 					[&, self = weak_impl(imp.shared_from_this())](
 						const boost::system::error_code& error,
-						std::size_t num_transferred
+						std::size_t bytes_transferred
 					) {
 						locked_impl impl_ = self.lock();
 						if (!impl_) return; // implementation has been destroyed
 
-						std::unique_lock<std::mutex> lock(imp.mutex);
-						if (imp.curstate != state::connected) {
-							return; // probably aborted
-						}
+						std::unique_lock<std::mutex> lock(imp.mutex);
+						if (imp.curstate != state::connected) {
+							return; // probably aborted
+						}
+
+						traffic_::add(imp.traffic.bytes_out, bytes_transferred);
+						std::size_t done = 0;
+						for(const auto &chunk : send_in_flight) {
+							done += chunk.length;
+						}
+						imp.traffic.record_dequeued(done);
+						send_in_flight.clear(); // releases buffers already written
+
+						if (error) {
+							imp.emit_error("Sending data failed: " + error.message(), error);
+							imp.do_unscheduled_disconnect();
+						}
+						else {
+							send();
+						}
+					};
+
+				// everything queued so far goes out in one gathered write
+				imp.transport->async_write(send_gather, send_callback);
+			}
+
+			impl &imp;
+			std::shared_ptr<slab> recv_slab;
+			std::shared_ptr<slab> recv_spill_slab; // second target of scattered reads
+			std::vector<std::shared_ptr<slab>> spare_slabs; // replaced, reused once no line refers to them
+			slab::size_type recv_begin; // begin of data not yet split into lines
+			slab::size_type recv_scan;  // where to continue looking for a line break
+			slab::size_type recv_end;   // end of data received so far
+			slab::size_type recv_read_size;
+			std::array<asio::mutable_buffer, 2> recv_buffers;
+			std::vector<util::line_span> recv_lines; // reused by emit_received_lines()
+			util::mpsc_queue<send_chunk> send_queue; // waiting to be written
+			std::atomic<bool> send_scheduled;        // a kick is posted or a send job is running
+			std::atomic<unsigned> corked_threads;    // threads that have the connection corked
+			std::mutex cork_mutex;
+			std::unordered_map<std::thread::id, cork_stage> cork_stages;
+			std::atomic<unsigned long long> sessions; // connections started or ended
+			std::vector<send_chunk> send_in_flight;  // being written
+			std::vector<asio::const_buffer> send_gather;
+			send_scheduler scheduler;
+			bool send_job_running;
+		} buffers;
+		struct statistics_ {
+			typedef std::chrono::steady_clock clock;
+
+			statistics_()
+			: connected_at()
+			, disconnected_at()
+			, reads_before(0)
+			, bytes_in_before(0)
+			, handshake_started()
+			, tls_handshakes(0)
+			, tls_resumptions(0)
+			, last_handshake_time(clock::duration::zero())
+			, last_handshake_resumed(false) {}
+
+			// the counters are kept in traffic_, spanning all connects
+			void record_connect(unsigned long long reads, unsigned long long bytes_in) {
+				connected_at = disconnected_at = clock::now();
+				reads_before = reads;
+				bytes_in_before = bytes_in;
+			}
+
+			void record_disconnect() {
+				disconnected_at = clock::now();
+			}
+
+			void record_handshake_start() {
+				handshake_started = clock::now();
+			}
+
+			void record_handshake(bool resumed) {
+				++tls_handshakes;
+				if (resumed) {
+					++tls_resumptions;
+				}
+				last_handshake_time = clock::now() - handshake_started;
+				last_handshake_resumed = resumed;
+			}
+
+			clock::time_point connected_at;
+			clock::time_point disconnected_at;
+			unsigned long long reads_before;    // traffic_::reads when connected
+			unsigned long long bytes_in_before; // traffic_::bytes_in when connected
+
+			// kept across connects
+			clock::time_point handshake_started;
+			unsigned long long tls_handshakes;
+			unsigned long long tls_resumptions;
+			clock::duration last_handshake_time;
+			bool last_handshake_resumed;
+		} stats;
+
+		// backs get_traffic_stats(), which reads it without locking the
+		// mutex; the counters are therefore relaxed atomics, written under
+		// the mutex except for send_queued, which producers add to from any
+		// thread
+		struct traffic_ {
+			typedef std::chrono::steady_clock clock;
+			typedef std::atomic<unsigned long long> counter;
+
+			traffic_()
+			: bytes_in(0)
+			, bytes_out(0)
+			, lines_in(0)
+			, lines_out(0)
+			, reads(0)
+			, writes(0)
+			, receive_buffered(0)
+			, send_queued(0)
+			, connected_since(0)
+			, reconnects(0)
+			, ping_rtt(0)
+			, connected_before(false)
+			, sent_partial_line(false)
+			, ping_pending(false)
+			, ping_token()
+			, ping_sent_at() {}
+
+			static void add(counter &value, unsigned long long amount) {
+				value.fetch_add(amount, std::memory_order_relaxed);
+			}
+
+			void record_connect() {
+				// assumes mutex to be locked!
+				connected_since.store(clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+				if (connected_before) {
+					add(reconnects, 1);
+				}
+				connected_before = true;
+				sent_partial_line = false;
+				ping_pending = false;
+			}
+
+			void record_disconnect() {
+				// assumes mutex to be locked!
+				connected_since.store(0, std::memory_order_relaxed);
+			}
+
+			void record_queued(std::size_t bytes) {
+				// can be called from any thread; mutex need not be locked
+				send_queued.fetch_add(bytes, std::memory_order_relaxed);
+			}
+
+			void record_dequeued(std::size_t bytes) {
+				// can be called from any thread; mutex need not be locked
+				send_queued.fetch_sub(bytes, std::memory_order_relaxed);
+			}
+
+			void record_write(const char *data, std::size_t length) {
+				// assumes mutex to be locked!
+				const char *line = data;
+				const char *const end = data + length;
+				unsigned long long lines = 0;
+				while(const char *eol = static_cast<const char*>(std::memchr(line, '\n', end - line))) {
+					if (!sent_partial_line) {
+						record_ping(line, eol);
+					}
+					sent_partial_line = false;
+					++lines;
+					line = eol + 1;
+				}
+				if (line != end) {
+					sent_partial_line = true;
+				}
+				add(lines_out, lines);
+			}
+
+			void record_received_line(const char *line, std::size_t length) {
+				// assumes mutex to be locked!
+				if (!ping_pending) return;
 
-						if (error) {
-							imp.emit_error("Sending data failed: " + error.message(), error);
-							imp.do_unscheduled_disconnect();
-						}
-						else {
-							current_send_state += num_transferred;
-							send();
-						}
-					};
+				const char *pos = line;
+				const char *const end = line + length;
+				if (pos < end && *pos == ':') { // skip prefix
+					while(pos < end && *pos != ' ') ++pos;
+					while(pos < end && *pos == ' ') ++pos;
+				}
+				if (end - pos < 5 || std::memcmp(pos, "PONG ", 5)) return;
+
+				if (last_parameter(pos + 5, end) == ping_token) {
+					const clock::rep sample = (clock::now() - ping_sent_at).count();
+					const clock::rep previous = ping_rtt.load(std::memory_order_relaxed);
+					ping_rtt.store(previous ? previous + (sample - previous) / 8 : sample, std::memory_order_relaxed);
+					ping_pending = false;
+				}
+			}
 
+			counter bytes_in;
+			counter bytes_out;
+			counter lines_in;
+			counter lines_out;
+			counter reads;
+			counter writes;
+			std::atomic<std::size_t> receive_buffered;
+			std::atomic<std::size_t> send_queued;
+			std::atomic<clock::rep> connected_since; // zero while not connected
+			counter reconnects;
+			std::atomic<clock::rep> ping_rtt; // zero until measured
+
+		private:
+			void record_ping(const char *line, const char *eol) {
+				// assumes mutex to be locked!
+				if (ping_pending || eol - line < 5 || std::memcmp(line, "PING ", 5)) return;
 
-				IF_SSL(imp.ssl,
-					imp.ssl->socket.async_write_some(
-						asio::const_buffers_1(&*current_send_state, send_buffer.end()-current_send_state),
-						send_callback
-					);
-				)
-				else {
-					imp.socket->async_write_some(
-						asio::const_buffers_1(&*current_send_state, send_buffer.end()-current_send_state),
-						send_callback
-					);
+				// only one PING is timed at a time; its PONG is answered
+				// before those of any later PINGs
+				ping_token = last_parameter(line + 5, eol);
+				ping_sent_at = clock::now();
+				ping_pending = true;
+			}
+
+			static std::string last_parameter(const char *begin, const char *end) {
+				while(begin < end && (end[-1] == '\r' || end[-1] == ' ')) --end;
+				for(const char *pos = begin; pos < end; ++pos) {
+					if (*pos == ':' && (pos == begin || pos[-1] == ' ')) {
+						return std::string(pos + 1, end);
+					}
 				}
+				const char *pos = end;
+				while(pos > begin && pos[-1] != ' ') --pos;
+				return std::string(pos, end);
 			}
 
-			impl &imp;
-			buffer send_buffer;
-			buffer fill_buffer;
-			std::string recv_buffer;
-			std::shared_ptr<raw_buffer> raw_recv_buffer;
-			buffer::iterator current_send_state;
-			bool send_job_running;
-		} buffers;
+			bool connected_before;
+			bool sent_partial_line; // the last line written was incomplete
+			bool ping_pending;
+			std::string ping_token;
+			clock::time_point ping_sent_at;
+		} traffic;
 
 	static constexpr unsigned default_port_nonssl = 6667;
 	static constexpr unsigned default_port_ssl    = 6697;
 
+	// the time to wait for a connection attempt before starting the next
+	// one in parallel (see RFC 8305, section 5)
+	static constexpr unsigned connection_attempt_delay_ms = 250;
+
+	// a session lasting this long resets the reconnect backoff even if the
+	// server never welcomed the client
+	static constexpr unsigned stable_session_s = 60;
+
 	impl(slirc::modules::connection &module)
 	: module(module)
 	, mutex()
 	, hostname("0.0.0.0")
 	, port(default_port_nonssl)
+	, local(false)
 	, curstate(state::disconnected)
-	, resolver()
-	, resolve_iterator()
-	, socket()
+	, send_service(nullptr)
+	, flood_timer()
+	, sockopts{ false, false, 0, false }
+	, registration()
+	, reconnect{
+		{ false, std::chrono::seconds(1), std::chrono::minutes(5), 2.0, 0.2 },
+		nullopt, 0, false, false, {}, std::minstd_rand(std::random_device()())
+	}
+	, delivery(connection::line_delivery::lines)
+	, line_derivations(nullptr)
+	, pings(connection::keepalive::off)
+	, resolve_round(0)
+	, race{ {}, 0, {}, nullopt, 0 }
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+	, local_attempt()
+#endif
+	, transport()
+	, transport_socket(nullptr)
+	, attached(false)
+	, capture{ { nullptr, &std::fclose }, {} }
 #ifndef SLIRC_BUILD_NO_SSL
 	, ssl()
 #endif
-	, buffers(*this) {}
+	, buffers(*this)
+	, stats()
+	, traffic() {}
 
 	void set_endpoint(const std::string &new_endpoint, unsigned new_port) {
 		std::unique_lock<std::mutex> lock(mutex);
@@ -253,6 +1874,10 @@ struct slirc::modules::connection::impl: std::enable_shared_from_this<impl> {
 				else if (proto == "ircs" || proto == "ssl") {
 					use_ssl = true;
 				}
+				else if (proto == "unix") {
+					// everything after "unix://" is the path
+					return set_local(new_endpoint.substr(pos+3));
+				}
 				else {
 					return set_invalid();
 				}
@@ -302,12 +1927,12 @@ struct slirc::modules::connection::impl: std::enable_shared_from_this<impl> {
 
 		hostname = new_endpoint.substr(server_port_begin, server_port_end-server_port_begin);
 		port = use_port;
+		local = false;
 
 		// set up either ssl or non-ssl, and tear down the other
 		if (use_ssl) {
 #ifndef SLIRC_BUILD_NO_SSL
-			ssl.emplace(network::service());
-			socket = nullopt;
+			ssl.emplace(network::service(), use_tls_context());
 #else
 			throw std::logic_error("Attempting to use SSL in libslirc, but libslirc was built without SSL support.");
 #endif
@@ -316,175 +1941,723 @@ struct slirc::modules::connection::impl: std::enable_shared_from_this<impl> {
 #ifndef SLIRC_BUILD_NO_SSL
 			ssl = nullopt;
 #endif
-			socket.emplace(network::service());
 		}
 	}
 
-	void connect() {
-		std::unique_lock<std::mutex> lock(mutex);
-		if (curstate != state::disconnected) {
-			throw exceptions::already_connected();
+	void connect() {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (curstate != state::disconnected) {
+			throw exceptions::already_connected();
+		}
+
+		cancel_reconnect();
+		reconnect.attempt = 0;
+		start_connecting();
+	}
+
+	void start_connecting() {
+		// assumes mutex to be locked, and state to be disconnected!
+
+		// Connecting happens in the following stages:
+		// - emit state::connecting (here)
+		// - host name look up (connect_resolve)
+		// - connecting to the looked up endpoints (connect_race, connect_try_next)
+		// - SSL handshake, if required (prepare_ssl_handshake)
+		// or, for Unix domain sockets
+		// - connecting to the socket (connect_local)
+		// - emit state::connected (connect_success)
+
+		prepare_service();
+		attached = false;
+		emit_state_change(state::connecting);
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+		if (local) {
+			connect_local();
+			return;
+		}
+#endif
+		connect_resolve();
+	}
+
+	void connect(std::shared_ptr<network::transport> established) {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (curstate != state::disconnected) {
+			throw exceptions::already_connected();
+		}
+
+		cancel_reconnect();
+		attach(std::move(established));
+	}
+
+	void attach(std::shared_ptr<network::transport> established) {
+		// assumes mutex to be locked, and state to be disconnected!
+		prepare_service();
+		attached = true; // there is nothing to reconnect to
+		emit_state_change(state::connecting);
+		connect_success(std::move(established), nullptr);
+	}
+
+	void prepare_service() {
+		// assumes mutex to be locked!
+		send_service = &network::service();
+		if (!flood_timer) {
+			flood_timer.emplace(network::service());
+		}
+		if (!race.timer) {
+			race.timer.emplace(network::service());
+		}
+		if (!reconnect.timer) {
+			reconnect.timer.emplace(network::service());
+		}
+	}
+
+	void disconnect() {
+		std::unique_lock<std::mutex> lock(mutex);
+		cancel_reconnect();
+		if (curstate == state::disconnecting || curstate == state::disconnected) {
+			return; // already disconnected or disconnecting
+		}
+
+		do_disconnect();
+	}
+
+	state current_state() {
+		std::unique_lock<std::mutex> lock(mutex);
+		return curstate;
+	}
+
+	void set_reconnect_policy(const connection::reconnect_policy &policy) {
+		std::unique_lock<std::mutex> lock(mutex);
+		reconnect.policy = policy;
+		if (!policy.enabled) {
+			cancel_reconnect();
+		}
+	}
+
+	connection::reconnect_policy get_reconnect_policy() {
+		std::unique_lock<std::mutex> lock(mutex);
+		return reconnect.policy;
+	}
+
+	void set_registration(std::string lines) {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (lines.empty()) {
+			registration.reset();
+		}
+		else {
+			registration = std::make_shared<const std::string>(std::move(lines));
+		}
+	}
+
+	void set_socket_options(const connection::socket_options &options) {
+		std::unique_lock<std::mutex> lock(mutex);
+		sockopts = options;
+		if (curstate == state::connected && transport_socket) {
+			apply_socket_options(*transport_socket);
+		}
+	}
+
+	connection::socket_options get_socket_options() {
+		std::unique_lock<std::mutex> lock(mutex);
+		return sockopts;
+	}
+
+#ifndef SLIRC_BUILD_NO_SSL
+	void set_tls_context(std::shared_ptr<asio::ssl::context> context) {
+		if (context) {
+			prepare_tls_context(*context);
+		}
+		std::unique_lock<std::mutex> lock(mutex);
+		tls_context = std::move(context);
+	}
+
+	std::shared_ptr<asio::ssl::context> get_tls_context() {
+		std::unique_lock<std::mutex> lock(mutex);
+		return use_tls_context();
+	}
+#endif
+
+	void set_flood_control(const connection::flood_control &limits) {
+		std::unique_lock<std::mutex> lock(mutex);
+		buffers.scheduler.configure(limits);
+		if (curstate == state::connected && !buffers.send_job_running) {
+			buffers.send(); // held back messages may be sendable now
+		}
+	}
+
+	connection::flood_control get_flood_control() {
+		std::unique_lock<std::mutex> lock(mutex);
+		return buffers.scheduler.limits;
+	}
+
+	void set_line_delivery(connection::line_delivery new_delivery) {
+		std::unique_lock<std::mutex> lock(mutex);
+		delivery = new_delivery;
+	}
+
+	connection::line_delivery get_line_delivery() {
+		std::unique_lock<std::mutex> lock(mutex);
+		return delivery;
+	}
+
+	// handles the internal event queued per read in line_delivery::lines
+	static void derive_line_events(event::pointer e) {
+		const received_line_batch &batch = e->components.at<received_line_batch>();
+		for(std::size_t i = 0; i < batch.size(); ++i) {
+			event::pointer line = e->irc.make_event(received_line);
+			line->components.insert(batch.line_data(i));
+			e->afterwards(line); // handled in order, before any later read
+		}
+	}
+
+	void set_keepalive(connection::keepalive mode) {
+		std::unique_lock<std::mutex> lock(mutex);
+		pings = mode;
+	}
+
+	connection::keepalive get_keepalive() {
+		std::unique_lock<std::mutex> lock(mutex);
+		return pings;
+	}
+
+	void start_capture(const std::string &path) {
+		std::unique_lock<std::mutex> lock(mutex);
+		std::unique_ptr<std::FILE, int(*)(std::FILE*)> file(std::fopen(path.c_str(), "wb"), &std::fclose);
+		if (!file || sizeof(capture_format::magic) != std::fwrite(capture_format::magic, 1, sizeof(capture_format::magic), file.get())) {
+			throw std::runtime_error("slirc::modules::connection - cannot write capture file " + path);
+		}
+		capture.file = std::move(file);
+		capture.last_record = std::chrono::steady_clock::now();
+	}
+
+	void stop_capture() {
+		std::unique_lock<std::mutex> lock(mutex);
+		capture.file.reset();
+	}
+
+	void replay(const std::string &path, connection::replay_pacing pacing) {
+		std::unique_lock<std::mutex> lock(mutex);
+		if (curstate != state::disconnected) {
+			throw exceptions::already_connected();
+		}
+
+		std::shared_ptr<replay_transport> capture;
+		try {
+			capture = std::make_shared<replay_transport>(path, pacing);
+		}
+		catch(boost::interprocess::interprocess_exception &) {
+			throw std::runtime_error("slirc::modules::connection - cannot read capture file " + path);
+		}
+		if (!capture->is_capture()) {
+			throw std::runtime_error("slirc::modules::connection - not a capture file: " + path);
+		}
+
+		cancel_reconnect();
+		attach(std::move(capture));
+	}
+
+	connection::statistics get_statistics() {
+		std::unique_lock<std::mutex> lock(mutex);
+
+		connection::statistics result;
+		result.reads = traffic.reads.load(std::memory_order_relaxed) - stats.reads_before;
+		result.bytes_in = traffic.bytes_in.load(std::memory_order_relaxed) - stats.bytes_in_before;
+		result.read_size = buffers.recv_read_size;
+		result.sends = buffers.scheduler.classes;
+		result.tls_handshakes = stats.tls_handshakes;
+		result.tls_resumptions = stats.tls_resumptions;
+		result.last_handshake_time = stats.last_handshake_time;
+		result.last_handshake_resumed = stats.last_handshake_resumed;
+		result.kernel_tls = false;
+		IF_SSL(ssl,
+			result.kernel_tls = (curstate == state::connected) && ssl->kernel_tx;
+		)
+		result.connected_for =
+			((curstate == state::connected) ? statistics_::clock::now() : stats.disconnected_at)
+			- stats.connected_at;
+		return result;
+	}
+
+	connection::traffic_stats get_traffic_stats() const {
+		// mutex need not be locked
+		const auto relaxed = std::memory_order_relaxed;
+
+		connection::traffic_stats result;
+		result.bytes_in = traffic.bytes_in.load(relaxed);
+		result.bytes_out = traffic.bytes_out.load(relaxed);
+		result.lines_in = traffic.lines_in.load(relaxed);
+		result.lines_out = traffic.lines_out.load(relaxed);
+		result.reads = traffic.reads.load(relaxed);
+		result.writes = traffic.writes.load(relaxed);
+		result.receive_buffered = traffic.receive_buffered.load(relaxed);
+		result.send_queued = traffic.send_queued.load(relaxed);
+		result.reconnects = traffic.reconnects.load(relaxed);
+		result.ping_rtt = traffic_::clock::duration(traffic.ping_rtt.load(relaxed));
+
+		const traffic_::clock::rep since = traffic.connected_since.load(relaxed);
+		result.connected_for = since
+			? traffic_::clock::now() - traffic_::clock::time_point(traffic_::clock::duration(since))
+			: traffic_::clock::duration::zero();
+		return result;
+	}
+
+private:
+	void connect_resolve() {
+		// assumes mutex to be locked!
+		network::detail::resolve(
+			hostname, port,
+			[&, self=weak_impl(shared_from_this()), round=resolve_round](
+				const boost::system::error_code &error,
+				const std::vector<asio::ip::tcp::endpoint> &endpoints
+			) {
+				locked_impl impl_ = self.lock();
+				if (!impl_) return; // implementation has been destroyed
+
+				std::unique_lock<std::mutex> lock(mutex);
+				if (curstate != state::connecting || round != resolve_round) {
+					return; // probably aborted
+				}
+
+				if (error) {
+					emit_error("Name lookup failed: " + error.message(), error);
+					do_unscheduled_disconnect();
+				}
+				else {
+					connect_race(endpoints);
+				}
+			}
+		);
+	}
+
+	void connect_race(const std::vector<asio::ip::tcp::endpoint> &endpoints) {
+		// assumes mutex to be locked!
+		clear_race();
+
+		// alternate between address families, starting with the family of
+		// the first result (see RFC 8305, section 4)
+		std::vector<asio::ip::tcp::endpoint> first_family, other_family;
+		for(const auto &endpoint : endpoints) {
+			if (first_family.empty() || endpoint.protocol() == first_family.front().protocol()) {
+				first_family.push_back(endpoint);
+			}
+			else {
+				other_family.push_back(endpoint);
+			}
+		}
+		for(std::size_t i=0; i < std::max(first_family.size(), other_family.size()); ++i) {
+			if (i < first_family.size()) race.endpoints.push_back(first_family[i]);
+			if (i < other_family.size()) race.endpoints.push_back(other_family[i]);
+		}
+
+		connect_try_next();
+	}
+
+	void connect_try_next() {
+		// assumes mutex to be locked!
+		if (race.next == race.endpoints.size()) {
+			if (race.attempts.empty()) {
+				do_unscheduled_disconnect(); // all attempts failed
+			}
+			return;
+		}
+
+		const auto attempt = std::make_shared<asio::ip::tcp::socket>(network::service());
+		race.attempts.push_back(attempt);
+		attempt->async_connect(
+			race.endpoints[race.next++],
+			[&, self=weak_impl(shared_from_this()), attempt, round=race.round](
+				const boost::system::error_code &error
+			) {
+				locked_impl impl_ = self.lock();
+				if (!impl_) return; // implementation has been destroyed
+
+				std::unique_lock<std::mutex> lock(mutex);
+				if (curstate != state::connecting || round != race.round) {
+					return; // probably aborted, or another attempt won
+				}
+
+				if (error) {
+					emit_error("Connection failed: " + error.message(), error);
+					race.attempts.erase(std::find(race.attempts.begin(), race.attempts.end(), attempt));
+					connect_try_next(); // don't wait for the delay to pass
+				}
+				else {
+					connect_race_won(*attempt);
+				}
+			}
+		);
+
+		// start the next attempt in parallel if this one takes too long
+		race.timer->expires_from_now(std::chrono::milliseconds(connection_attempt_delay_ms));
+		race.timer->async_wait(
+			[&, self=weak_impl(shared_from_this()), round=race.round](
+				const boost::system::error_code &error
+			) {
+				locked_impl impl_ = self.lock();
+				if (!impl_) return; // implementation has been destroyed
+				if (error) return; // cancelled
+
+				std::unique_lock<std::mutex> lock(mutex);
+				if (curstate != state::connecting || round != race.round) {
+					return; // probably aborted, or another attempt won
+				}
+
+				connect_try_next();
+			}
+		);
+	}
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+	asio::local::stream_protocol::endpoint local_endpoint() const {
+		// assumes mutex to be locked, and the endpoint to be local!
+		if (hostname[0] == '@') {
+			// the abstract namespace (Linux), where names start with a null byte
+			return asio::local::stream_protocol::endpoint(std::string(1, '\0') + hostname.substr(1));
+		}
+		return asio::local::stream_protocol::endpoint(hostname);
+	}
+
+	void connect_local() {
+		// assumes mutex to be locked!
+		clear_race();
+
+		const auto attempt = std::make_shared<asio::local::stream_protocol::socket>(network::service());
+		local_attempt = attempt;
+		attempt->async_connect(
+			local_endpoint(),
+			[&, self=weak_impl(shared_from_this()), attempt, round=race.round](
+				const boost::system::error_code &error
+			) {
+				locked_impl impl_ = self.lock();
+				if (!impl_) return; // implementation has been destroyed
+
+				std::unique_lock<std::mutex> lock(mutex);
+				if (curstate != state::connecting || round != race.round) {
+					return; // probably aborted
+				}
+
+				local_attempt.reset();
+				if (error) {
+					emit_error("Connection failed: " + error.message(), error);
+					do_unscheduled_disconnect();
+				}
+				else {
+					// no TCP socket options apply
+					connect_success(std::make_shared<local_transport>(std::move(*attempt)), nullptr);
+				}
+			}
+		);
+	}
+#endif
+
+#ifndef SLIRC_BUILD_NO_SSL
+	std::shared_ptr<asio::ssl::context> use_tls_context() {
+		// assumes mutex to be locked!
+		return tls_context ? tls_context : connection::default_tls_context();
+	}
+#endif
+
+	void connect_race_won(asio::ip::tcp::socket &winner) {
+		// assumes mutex to be locked!
+		asio::ip::tcp::socket connected(std::move(winner));
+		clear_race(); // cancels the other attempts
+
+		IF_SSL(ssl,
+			// a fresh stream per connection, as SSL objects cannot do a
+			// second handshake
+			ssl.emplace(network::service(), use_tls_context());
+			ssl->socket.next_layer().next_layer() = std::move(connected);
+			prepare_ssl_handshake();
+		)
+		else {
+			auto established = std::make_shared<tcp_transport>(std::move(connected));
+			tcp_socket &sock = established->next_layer();
+			connect_success(std::move(established), &sock);
+		}
+	}
+
+	void clear_race() {
+		// assumes mutex to be locked!
+		++race.round;
+		if (race.timer) {
+			race.timer->cancel();
 		}
-
-		// Connecting happens in the following stages:
-		// - emit state::connecting (here)
-		// - host name look up (connect_resolve)
-		// - connecting to the looked up endpoint (connect_try_next)
-		// - SSL handshake, if required (connect_opt_ssl_handshake)
-		// - emit state::connected (connect_success)
-
-		emit_state_change(state::connecting);
-		connect_resolve();
+		for(const auto &attempt : race.attempts) {
+			boost::system::error_code ec;
+			attempt->close(ec); // ignore error code
+		}
+		race.attempts.clear();
+		race.endpoints.clear();
+		race.next = 0;
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+		if (local_attempt) {
+			boost::system::error_code ec;
+			local_attempt->close(ec); // ignore error code
+			local_attempt.reset();
+		}
+#endif
 	}
 
-	void disconnect() {
-		std::unique_lock<std::mutex> lock(mutex);
-		if (curstate == state::disconnecting || curstate == state::disconnected) {
-			return; // already disconnected or disconnecting
+#ifndef SLIRC_BUILD_NO_SSL
+	void prepare_ssl_handshake() {
+		// assumes mutex to be locked!
+
+		// offer the session of the last connection to this endpoint
+		ssl->state.session_key = hostname + ":" + std::to_string(port);
+		ssl->state.want_traffic_secret = want_kernel_tls();
+		SSL *native = ssl->socket.native_handle();
+		SSL_set_ex_data(native, tls_state_index(), &ssl->state);
+		if (ssl->state.want_traffic_secret) {
+			capture_traffic_secrets(SSL_get_SSL_CTX(native));
+		}
+		if (auto session = tls_session_cache::instance().find(ssl->state.session_key)) {
+			SSL_set_session(native, session.get());
 		}
 
-		do_disconnect();
-	}
+		stats.record_handshake_start();
+		if (asio::io_service *pool = network::detail::handshake_service()) {
+			// even creating the first handshake message takes a key exchange
+			ssl->socket.next_layer().complete_on(pool);
+			pool->post([&, self=weak_impl(shared_from_this()), round=race.round]() {
+				locked_impl impl_ = self.lock();
+				if (!impl_) return; // implementation has been destroyed
 
-	state current_state() {
-		std::unique_lock<std::mutex> lock(mutex);
-		return curstate;
+				std::unique_lock<std::mutex> lock(mutex);
+				if (curstate != state::connecting || round != race.round) {
+					return; // probably aborted
+				}
+				ssl_handshake();
+			});
+		}
+		else {
+			ssl_handshake();
+		}
 	}
 
-private:
-	void connect_resolve() {
+	void ssl_handshake() {
 		// assumes mutex to be locked!
-		resolver.emplace(network::service());
-		resolver->async_resolve(
-			tcp_resolver::query(
-				hostname,
-				std::to_string(port)
-			),
-			[&, self=weak_impl(shared_from_this())](
-				const boost::system::error_code &error,
-				tcp_resolver::iterator iterator
+		ssl->socket.async_handshake(
+			asio::ssl::stream<tcp_socket>::client,
+			[&, self=weak_impl(shared_from_this()), round=race.round](
+				const boost::system::error_code &error
 			) {
 				locked_impl impl_ = self.lock();
 				if (!impl_) return; // implementation has been destroyed
 
 				std::unique_lock<std::mutex> lock(mutex);
-				if (curstate != state::connecting) {
+				if (curstate != state::connecting || round != race.round) {
 					return; // probably aborted
 				}
 
+				// back to the network service
+				ssl->socket.next_layer().complete_on(nullptr);
+
 				if (error) {
-					emit_error("Name lookup failed: " + error.message(), error);
+					// do not offer a session the server might have choked on
+					tls_session_cache::instance().forget(ssl->state.session_key);
+					emit_error("SSL handshake failed: " + error.message(), error);
 					do_unscheduled_disconnect();
 				}
 				else {
-					resolve_iterator = iterator;
-					connect_try_next();
+					stats.record_handshake(
+						SSL_session_reused(ssl->socket.native_handle()) != 0);
+					try_kernel_tls();
+					connect_success(
+						std::make_shared<ssl_stream_transport>(ssl->socket, ssl->kernel_tx),
+						&ssl->socket.lowest_layer());
 				}
 			}
 		);
 	}
+#endif
 
-	void connect_try_next() {
+#ifndef SLIRC_BUILD_NO_SSL
+	bool want_kernel_tls() const {
 		// assumes mutex to be locked!
-		if (resolve_iterator == decltype(resolve_iterator){}) {
-			do_unscheduled_disconnect();
-		}
-		else {
-			auto &sock = get_socket();
-			sock.async_connect(
-				*resolve_iterator,
-				[&, self=weak_impl(shared_from_this())](
-					const boost::system::error_code &error
-				) {
-					locked_impl impl_ = self.lock();
-					if (!impl_) return; // implementation has been destroyed
-
-					std::unique_lock<std::mutex> lock(mutex);
-					if (curstate != state::connecting) {
-						return; // probably aborted
-					}
-
-					if (error) {
-						emit_error("Connection failed: " + error.message(), error);
-						connect_try_next();
-					}
-					else {
-						connect_opt_ssl_handshake();
-					}
-				}
-			);
-			++resolve_iterator;
-		}
+#ifdef SLIRC_HAVE_KTLS
+		return sockopts.kernel_tls;
+#else
+		return false;
+#endif
 	}
 
-	void connect_opt_ssl_handshake() {
-		// assumes mutex to be locked!
-		IF_SSL(ssl,
-			ssl->socket.async_handshake(
-				asio::ssl::stream<tcp_socket>::client,
-				[&, self=weak_impl(shared_from_this())](
-					const boost::system::error_code &error
-				) {
-					locked_impl impl_ = self.lock();
-					if (!impl_) return; // implementation has been destroyed
-
-					std::unique_lock<std::mutex> lock(mutex);
-					if (curstate != state::connecting) {
-						return; // probably aborted
-					}
-
-					if (error) {
-						emit_error("SSL handshake failed: " + error.message(), error);
-					}
-					else {
-						connect_success();
-					}
-				}
-			);
-		)
-		else {
-			connect_success();
+	void try_kernel_tls() {
+		// assumes mutex to be locked, and the handshake to have just completed!
+#ifdef SLIRC_HAVE_KTLS
+		if (ssl->state.want_traffic_secret) {
+			// falls back to encrypting in OpenSSL if the kernel lacks kTLS
+			// or the cipher is not supported
+			ssl->kernel_tx = enable_kernel_tls_tx(
+				ssl->socket.native_handle(),
+				ssl->socket.next_layer().next_layer().native_handle(),
+				ssl->state.client_traffic_secret);
+			if (ssl->kernel_tx) {
+				// OpenSSL's record sequence is behind the kernel's from now
+				// on, so it must never write again: no close_notify, and
+				// any other record it has to send ends the connection
+				SSL_set_quiet_shutdown(ssl->socket.native_handle(), 1);
+				ssl->socket.next_layer().seal_output();
+			}
 		}
+#endif
+		ssl->state.forget_traffic_secret();
 	}
+#endif
 
-	void connect_success() {
+	void connect_success(std::shared_ptr<network::transport> established, tcp_socket *sock) {
 		// assumes mutex to be locked!
 		clear_resolver(); // no longer needed
+		clear_race();
+		transport = std::move(established);
+		transport_socket = sock;
 		buffers.clear();
+		buffers.scheduler.reset_statistics();
+		if (registration) {
+			// queued before anything the connected event's handlers send, so
+			// it goes out pipelined in the first write
+			buffers.append(
+				std::shared_ptr<const char>(registration, registration->data()),
+				registration->size());
+		}
+		// the backoff is only reset once the session turns out to be up,
+		// so a server accepting and dropping connections is not hammered
+		reconnect.welcomed = false;
+		reconnect.connected_at = std::chrono::steady_clock::now();
+		if (transport_socket) {
+			apply_socket_options(*transport_socket);
+		}
+		stats.record_connect(
+			traffic.reads.load(std::memory_order_relaxed),
+			traffic.bytes_in.load(std::memory_order_relaxed));
+		traffic.record_connect();
 		emit_state_change(state::connected);
 		recv();
 	}
 
 
 
-	void clear_resolver() {
-		if (resolver) {
-			resolver->cancel();
-			resolver = nullopt;
-			resolve_iterator = decltype(resolve_iterator){};
+	void apply_socket_options(tcp_socket &sock) {
+		// assumes mutex to be locked, and the socket to be connected!
+		boost::system::error_code ec;
+
+		sock.set_option(asio::ip::tcp::no_delay(sockopts.no_delay), ec);
+		if (ec) {
+			emit_error("Setting TCP_NODELAY failed: " + ec.message(), ec);
+		}
+
+#ifdef TCP_CORK
+		sock.set_option(tcp_cork(sockopts.cork), ec);
+		if (ec) {
+			emit_error("Setting TCP_CORK failed: " + ec.message(), ec);
+		}
+#endif
+
+		if (sockopts.send_buffer_size) {
+			sock.set_option(asio::socket_base::send_buffer_size(static_cast<int>(sockopts.send_buffer_size)), ec);
+			if (ec) {
+				emit_error("Setting the send buffer size failed: " + ec.message(), ec);
+			}
 		}
 	}
 
+	void wait_for_flood_control(std::chrono::steady_clock::duration delay) {
+		// assumes mutex to be locked, and the connection to be established!
+		flood_timer->expires_from_now(delay); // cancels a previous wait
+		flood_timer->async_wait(
+			[&, self=weak_impl(shared_from_this())](const boost::system::error_code &error) {
+				locked_impl impl_ = self.lock();
+				if (!impl_) return; // implementation has been destroyed
+				if (error) return; // cancelled
+
+				std::unique_lock<std::mutex> lock(mutex);
+				buffers.kicked();
+			}
+		);
+	}
+
+	void clear_resolver() {
+		// assumes mutex to be locked!
+		++resolve_round; // the shared lookup keeps running; ignore its result
+	}
+
 	void do_disconnect() {
 		boost::system::error_code ec;
 		// assumes mutex to be locked, and state to be connecting or connected!
 		emit_state_change(state::disconnecting);
-		do_unscheduled_disconnect();
+		do_unscheduled_disconnect(false);
 	}
 
-	void do_unscheduled_disconnect() {
+	void do_unscheduled_disconnect(bool allow_reconnect = true) {
 		// assumes mutex to be locked, and state to be connecting or connected!
-		boost::system::error_code ec;
+		if (transport) {
+			transport->close();
+			transport.reset();
+			transport_socket = nullptr;
+		}
+		IF_SSL(ssl,
+			// the handshake may still be running
+			boost::system::error_code ec;
+			ssl->socket.lowest_layer().close(ec); // ignore error code
+		)
 
-		auto &sock = get_socket();
-		sock.shutdown(tcp_socket::shutdown_both, ec); // ignore error code
-		sock.cancel();
-		sock.close(ec); // ignore error code
+		if (curstate == state::connected) {
+			stats.record_disconnect();
+			if (reconnect.welcomed
+				|| std::chrono::seconds(stable_session_s) <= std::chrono::steady_clock::now() - reconnect.connected_at) {
+				reconnect.attempt = 0;
+			}
+		}
+		traffic.record_disconnect(); // also when disconnecting on request
 
 		clear_resolver();
+		clear_race();
 		buffers.clear();
 
 		emit_state_change(state::disconnected);
+
+		if (allow_reconnect && !attached && reconnect.policy.enabled) {
+			schedule_reconnect();
+		}
+	}
+
+	void schedule_reconnect() {
+		// assumes mutex to be locked, and state to be disconnected!
+		const auto &policy = reconnect.policy;
+
+		// exponential backoff, randomly spread by the jitter factor
+		double delay = std::chrono::duration<double>(policy.initial_delay).count()
+			* std::pow(std::max(1.0, policy.multiplier), reconnect.attempt);
+		delay = std::min(delay, std::chrono::duration<double>(policy.max_delay).count());
+		const double jitter = std::min(std::max(policy.jitter, 0.0), 1.0);
+		delay *= std::uniform_real_distribution<double>(1.0 - jitter, 1.0 + jitter)(reconnect.random);
+
+		++reconnect.attempt;
+		reconnect.pending = true;
+		reconnect.timer->expires_from_now(
+			std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(delay)));
+		reconnect.timer->async_wait(
+			[&, self=weak_impl(shared_from_this())](const boost::system::error_code &error) {
+				locked_impl impl_ = self.lock();
+				if (!impl_) return; // implementation has been destroyed
+				if (error) return; // cancelled
+
+				std::unique_lock<std::mutex> lock(mutex);
+				if (!reconnect.pending || curstate != state::disconnected) {
+					return; // cancelled or connected manually in the meantime
+				}
+
+				reconnect.pending = false;
+				start_connecting();
+			}
+		);
+	}
+
+	void cancel_reconnect() {
+		// assumes mutex to be locked!
+		if (reconnect.pending) {
+			reconnect.pending = false;
+			reconnect.timer->cancel();
+		}
 	}
 
 	void emit_error(std::string &&error_message, const boost::system::error_code &error_code) {
@@ -494,12 +2667,6 @@ private:
 		e->queue();
 	}
 
-	void emit_line(std::string &&line) {
-		event::pointer e = module.irc.make_event(received_line);
-		e->components.insert(received_data()).data = std::move(line);
-		e->queue();
-	}
-
 	void emit_state_change(state newstate) {
 		// assumes mutex to be locked!
 		if (curstate != newstate) {
@@ -511,63 +2678,115 @@ private:
 		}
 	}
 
-	tcp_socket &get_socket() {
+	void emit_received_lines() {
 		// assumes mutex to be locked!
-#ifndef SLIRC_BUILD_NO_SSL
-		SLIRC_ASSERT( (socket || ssl)
-			&& "neither non-ssl nor ssl is initialized!" );
-#else
-		SLIRC_ASSERT( (socket)
-			&& "socket is not initialized!" );
-#endif
+		auto &buf = buffers;
+		const char *const data = buf.recv_slab->data() + buf.recv_begin;
+
+		buf.recv_lines.clear();
+		const auto consumed = util::index_lines(
+			data, buf.recv_end - buf.recv_begin,
+			buf.recv_lines,
+			std::max(buf.recv_scan, buf.recv_begin) - buf.recv_begin);
+
+		event::pointer batch_event;
+		received_line_batch *batch = nullptr;
+		if (!buf.recv_lines.empty()) {
+			// the per-line events are derived from the batch when handled
+			batch_event = module.irc.make_event(delivery == connection::line_delivery::lines
+				? event::id_type(derive_received_line_events)
+				: event::id_type(received_lines));
+			if (delivery == connection::line_delivery::lines_and_batches) {
+				batch_event->queue_as(derive_received_line_events);
+			}
+			batch = &batch_event->components.insert(received_line_batch());
+			batch->assign(std::shared_ptr<const char>(buf.recv_slab, data));
+		}
+
+		// trim the lines, dropping empty ones
+		unsigned long long received = 0;
+		bool answered = false;
+		for(const auto &line : buf.recv_lines) {
+			auto begin = line.begin;
+			const auto end = line.begin + line.length;
+			while(begin < end && (data[begin] == ' ' || data[begin] == '\r')) {
+				++begin;
+			}
+			if (begin == end) continue;
+
+			++received;
+			traffic.record_received_line(data + begin, end - begin);
+			if (!reconnect.welcomed) {
+				reconnect.welcomed = is_welcome(data + begin, end - begin);
+			}
+			if (pings != connection::keepalive::off && answer_ping(data + begin, end - begin)) {
+				answered = true;
+				if (pings == connection::keepalive::answer) {
+					continue; // observers are not interested
+				}
+			}
 
-		if (socket) {
-			return *socket;
+			batch->add(begin, end - begin);
 		}
-		else IF_SSL(ssl,
-			return ssl->socket.lowest_layer();
-		)
-		else {
-			throw std::logic_error(
-				"slirc::module::connection - socket is requested, "
-				"but neither ssl nor non-ssl is initialized");
+		if (answered) {
+			buf.send_pushed(); // right away, instead of posting a kick
 		}
-	}
 
-	void recv() {
-		// assumes mutex to be locked!
-		SLIRC_ASSERT( curstate == state::connected
-			&& "must be connected to receive!" );
+		if (batch && !batch->empty()) {
+			batch_event->queue();
+		}
 
-		std::string::size_type line_begin=0, line_end=0;
+		buf.recv_begin += consumed;
+		buf.recv_scan = buf.recv_end;
+		traffic_::add(traffic.lines_in, received);
+		traffic.receive_buffered.store(buf.recv_end - buf.recv_begin, std::memory_order_relaxed);
+	}
 
-		while(true) {
-			auto &buf = buffers.recv_buffer;
+	static bool is_welcome(const char *line, std::size_t length) {
+		const char *pos = line;
+		const char *const end = line + length;
+		if (pos < end && *pos == ':') { // skip prefix
+			while(pos < end && *pos != ' ') ++pos;
+			while(pos < end && *pos == ' ') ++pos;
+		}
+		return 3 <= end - pos && !std::memcmp(pos, "001", 3) && (end - pos == 3 || pos[3] == ' ');
+	}
 
-			line_begin = buf.find_first_not_of(" \r\n", line_end);
-			if (line_begin == std::string::npos) {
-				buf.clear();
-				break;
-			}
+	bool answer_ping(const char *line, std::size_t length) {
+		// assumes mutex to be locked!
+		const char *pos = line;
+		const char *const end = line + length;
+		if (pos < end && *pos == ':') { // skip prefix
+			while(pos < end && *pos != ' ') ++pos;
+			while(pos < end && *pos == ' ') ++pos;
+		}
+		const auto upper = [](char c) { return ('a' <= c && c <= 'z') ? char(c + 'A' - 'a') : c; };
+		if (end - pos < 4 || (end - pos > 4 && pos[4] != ' ')
+			|| upper(pos[0]) != 'P' || upper(pos[1]) != 'I' || upper(pos[2]) != 'N' || upper(pos[3]) != 'G') {
+			return false;
+		}
 
-			line_end = buffers.recv_buffer.find("\n", line_begin);
-			if (line_end == std::string::npos) {
-				buf.erase(0, line_begin);
-				break;
-			}
+		// the PONG repeats the parameters of the PING
+		const auto pong = std::make_shared<std::string>("PONG");
+		pong->append(pos + 4, end);
+		while(pong->back() == '\r') pong->pop_back();
+		*pong += "\r\n";
+		buffers.push_unstaged(std::shared_ptr<const char>(pong, pong->data()), pong->size());
+		return true;
+	}
 
-			if (buf[line_end-1] == '\r') {
-				--line_end;
-			}
+	void recv() {
+		// assumes mutex to be locked!
+		SLIRC_ASSERT( curstate == state::connected
+			&& "must be connected to receive!" );
 
-			emit_line(buf.substr(line_begin, line_end-line_begin));
-		}
+		buffers.prepare_recv();
 
 		const auto recv_handler =
-			[&, self=weak_impl(shared_from_this()), buf=buffers.raw_recv_buffer](
+			[&, self=weak_impl(shared_from_this()), buf=buffers.recv_slab, spill_buf=buffers.recv_spill_slab](
 				const boost::system::error_code& error,
 				std::size_t bytes_transferred
-			){
+			) mutable {
 				locked_impl impl_ = self.lock();
 				if (!impl_) return; // implementation has been destroyed
 
@@ -577,36 +2796,106 @@ private:
 				}
 
 				if (error) {
-					emit_error("Connection failed: " + error.message(), error);
+					if (const char *reason = kernel_tls_failure()) {
+						emit_error(std::string("Connection failed: ") + reason, error);
+					}
+					else if (!attached || error != asio::error::eof) {
+						// a handed in transport simply ends
+						emit_error("Connection failed: " + error.message(), error);
+					}
 					do_unscheduled_disconnect();
 				}
 				else {
-					buffers.recv_buffer.append(
-						&*buffers.raw_recv_buffer->begin(),
-						bytes_transferred
-					);
-					recv();
+					if (capture.file) {
+						capture_received(bytes_transferred);
+					}
+					traffic_::add(traffic.reads, 1);
+					traffic_::add(traffic.bytes_in, bytes_transferred);
+					buffers.complete_recv(bytes_transferred, [&]{ emit_received_lines(); });
+
+					// the buffers hold on to the slabs now; without these
+					// references, a slab no line refers to any more can be
+					// reused in place
+					buf.reset();
+					spill_buf.reset();
+					if (const char *reason = kernel_tls_failure()) {
+						emit_error(std::string("Connection failed: ") + reason, boost::system::error_code());
+						do_unscheduled_disconnect();
+					}
+					else {
+						recv();
+					}
 				}
 			};
 
+		// a null buffer at the end of a scatter read is harmless
+		transport->async_read_some(buffers.recv_buffers, recv_handler);
+	}
+
+	// with kTLS, OpenSSL cannot send what the server asks of it; returns
+	// why the connection cannot go on, or nullptr
+	const char *kernel_tls_failure() {
+		// assumes mutex to be locked!
 		IF_SSL(ssl,
-			ssl->socket.async_read_some(
-				asio::mutable_buffers_1(
-					&*buffers.raw_recv_buffer->begin(),
-					buffers.raw_recv_buffer->size()
-				),
-				recv_handler
-			);
+			if (ssl->kernel_tx && ssl->socket.next_layer().output_refused()) {
+				return "OpenSSL has a TLS record to send (such as an alert),"
+					" which it cannot send while the kernel encrypts sent data";
+			}
+#ifdef SLIRC_HAVE_KTLS
+			// OpenSSL only answers with the next SSL_write(), which never comes
+			if (ssl->kernel_tx && SSL_get_key_update_type(ssl->socket.native_handle()) != SSL_KEY_UPDATE_NONE) {
+				return "the server requested a key update, which the kernel"
+					" encrypting sent data cannot follow";
+			}
+#endif
 		)
-		else {
-			socket->async_read_some(
-				asio::mutable_buffers_1(
-					&*buffers.raw_recv_buffer->begin(),
-					buffers.raw_recv_buffer->size()
-				),
-				recv_handler
-			);
+		return nullptr;
+	}
+
+	void capture_received(std::size_t bytes_transferred) {
+		// assumes mutex to be locked, and bytes_transferred bytes to have
+		// been read into the receive buffers!
+		const auto now = std::chrono::steady_clock::now();
+		std::FILE *const file = capture.file.get();
+		bool ok =
+			capture_format::put_varint(file, std::chrono::duration_cast<std::chrono::microseconds>(now - capture.last_record).count())
+			&& capture_format::put_varint(file, bytes_transferred);
+		for(const auto &buffer : buffers.recv_buffers) {
+			const std::size_t part = std::min(asio::buffer_size(buffer), bytes_transferred);
+			ok = ok && part == std::fwrite(asio::buffer_cast<const char*>(buffer), 1, part, file);
+			bytes_transferred -= part;
+		}
+		capture.last_record = now;
+
+		if (!ok) {
+			capture.file.reset();
+			emit_error("Writing the capture failed; capturing stopped.", boost::system::error_code());
+		}
+	}
+
+	void set_local(std::string path) {
+		// assumes mutex to be locked!
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+		hostname = std::move(path);
+		port = 0;
+		local = true;
+#ifndef SLIRC_BUILD_NO_SSL
+		ssl = nullopt;
+#endif
+
+		if (hostname.empty() || hostname == "@") {
+			return set_invalid();
+		}
+		try {
+			local_endpoint(); // checks the length of the path
+		}
+		catch(boost::system::system_error &) {
+			return set_invalid();
 		}
+#else
+		((void)path);
+		throw std::logic_error("Attempting to use a Unix domain socket in libslirc, but the platform does not support them.");
+#endif
 	}
 
 	void set_invalid() {
@@ -615,6 +2904,7 @@ private:
 			&& "must not change endpoint while connected or connecting");
 		hostname = "0.0.0.0";
 		port = 0;
+		local = false;
 #ifndef SLIRC_BUILD_NO_SSL
 		ssl = nullopt;
 #endif
@@ -623,10 +2913,16 @@ private:
 
 slirc::modules::connection::connection(slirc::irc &irc)
 : apis::connection(irc)
-, impl_(std::make_shared<impl>(*this)) {}
+, impl_(std::make_shared<impl>(*this)) {
+	// the event manager may be shared with other contexts, whose
+	// connections share its handler
+	impl_->line_derivations = &irc.event_manager();
+	line_event_derivations::instance().add(irc.event_manager(), &impl::derive_line_events);
+}
 
 slirc::modules::connection::~connection() {
 	impl_->disconnect();
+	line_event_derivations::instance().remove(*impl_->line_derivations);
 }
 
 void slirc::modules::connection::set_endpoint(const std::string &endpoint, unsigned port) {
@@ -637,6 +2933,10 @@ void slirc::modules::connection::connect() {
 	impl_->connect();
 }
 
+void slirc::modules::connection::connect(std::shared_ptr<network::transport> transport) {
+	impl_->connect(std::move(transport));
+}
+
 void slirc::modules::connection::disconnect() {
 	impl_->disconnect();
 }
@@ -645,6 +2945,127 @@ slirc::modules::connection::state slirc::modules::connection::current_state() {
 	return impl_->current_state();
 }
 
+void slirc::modules::connection::set_line_delivery(line_delivery delivery) {
+	impl_->set_line_delivery(delivery);
+}
+
+slirc::modules::connection::line_delivery slirc::modules::connection::get_line_delivery() {
+	return impl_->get_line_delivery();
+}
+
+void slirc::modules::connection::set_keepalive(keepalive mode) {
+	impl_->set_keepalive(mode);
+}
+
+slirc::modules::connection::keepalive slirc::modules::connection::get_keepalive() {
+	return impl_->get_keepalive();
+}
+
+void slirc::modules::connection::start_capture(const std::string &path) {
+	impl_->start_capture(path);
+}
+
+void slirc::modules::connection::stop_capture() {
+	impl_->stop_capture();
+}
+
+void slirc::modules::connection::replay(const std::string &path, replay_pacing pacing) {
+	impl_->replay(path, pacing);
+}
+
+void slirc::modules::connection::set_reconnect_policy(const reconnect_policy &policy) {
+	impl_->set_reconnect_policy(policy);
+}
+
+slirc::modules::connection::reconnect_policy slirc::modules::connection::get_reconnect_policy() {
+	return impl_->get_reconnect_policy();
+}
+
+void slirc::modules::connection::set_registration(std::string lines) {
+	impl_->set_registration(std::move(lines));
+}
+
+void slirc::modules::connection::set_socket_options(const socket_options &options) {
+	impl_->set_socket_options(options);
+}
+
+slirc::modules::connection::socket_options slirc::modules::connection::get_socket_options() {
+	return impl_->get_socket_options();
+}
+
+std::shared_ptr<boost::asio::ssl::context> slirc::modules::connection::default_tls_context() {
+#ifndef SLIRC_BUILD_NO_SSL
+	static const std::shared_ptr<asio::ssl::context> context = []{
+		auto context = std::make_shared<asio::ssl::context>(asio::ssl::context::sslv23_client);
+		prepare_tls_context(*context);
+		return context;
+	}();
+	return context;
+#else
+	throw std::logic_error("Attempting to use SSL in libslirc, but libslirc was built without SSL support.");
+#endif
+}
+
+void slirc::modules::connection::set_tls_context(std::shared_ptr<boost::asio::ssl::context> context) {
+#ifndef SLIRC_BUILD_NO_SSL
+	impl_->set_tls_context(std::move(context));
+#else
+	((void)context); // unused without SSL support
+	throw std::logic_error("Attempting to use SSL in libslirc, but libslirc was built without SSL support.");
+#endif
+}
+
+std::shared_ptr<boost::asio::ssl::context> slirc::modules::connection::get_tls_context() {
+#ifndef SLIRC_BUILD_NO_SSL
+	return impl_->get_tls_context();
+#else
+	throw std::logic_error("Attempting to use SSL in libslirc, but libslirc was built without SSL support.");
+#endif
+}
+
+void slirc::modules::connection::set_flood_control(const flood_control &limits) {
+	impl_->set_flood_control(limits);
+}
+
+slirc::modules::connection::flood_control slirc::modules::connection::get_flood_control() {
+	return impl_->get_flood_control();
+}
+
+slirc::modules::connection::statistics slirc::modules::connection::get_statistics() {
+	return impl_->get_statistics();
+}
+
+slirc::apis::connection::traffic_stats slirc::modules::connection::do_get_traffic_stats() {
+	return impl_->get_traffic_stats();
+}
+
+double slirc::modules::connection::statistics::reads_per_second() const {
+	const double seconds = std::chrono::duration<double>(connected_for).count();
+	return (0 < seconds) ? reads / seconds : 0;
+}
+
+std::chrono::steady_clock::duration slirc::modules::connection::statistics::send_class::average_delay() const {
+	return sent
+		? total_delay / static_cast<std::chrono::steady_clock::rep>(sent)
+		: std::chrono::steady_clock::duration::zero();
+}
+
+double slirc::modules::connection::statistics::bytes_per_read() const {
+	return reads ? static_cast<double>(bytes_in) / reads : 0;
+}
+
+void slirc::modules::connection::do_cork() {
+	impl_->buffers.cork();
+}
+
+void slirc::modules::connection::do_uncork() {
+	impl_->buffers.uncork();
+}
+
 void slirc::modules::connection::do_send_raw(const char *data, std::size_t length) {
 	impl_->buffers.append(data, length);
 }
+
+void slirc::modules::connection::do_send_raw(std::shared_ptr<const char> data, std::size_t length) {
+	impl_->buffers.append(std::move(data), length);
+}
@@ -55,24 +55,6 @@ namespace {
 		}
 	};
 
-	void try_unqueue(
-		std::deque<slirc::event::pointer> &queue,
-		std::vector<slirc::apis::event_manager::event_consumer_type> &queue_consumers,
-		std::vector<slirc::apis::event_manager::event_consumer_type>::size_type &queue_consumer_index
-	) {
-		// requires: mutex for variables is locked!
-		while(!queue.empty() && queue_consumer_index < queue_consumers.size()) {
-			if (queue_consumers[queue_consumer_index++](queue.front())) {
-				// event is taken and being handled
-				queue.pop_front();
-			}
-		}
-
-		if (queue_consumer_index && queue_consumer_index == queue_consumers.size()) {
-			queue_consumers.resize(queue_consumer_index = 0);
-		}
-	}
-
 	struct returning_wait_event_consumer_data {
 		std::mutex mutex;
 		std::condition_variable condvar;
@@ -110,10 +92,34 @@ namespace {
 }
 
 struct slirc::modules::event_manager::impl {
+	typedef unsigned long long position_type;
+
+	// Queued events are numbered so the queue stays sorted by number:
+	// counting up from the middle of the range at the back, and down at the
+	// front.
+	struct queued_event {
+		event::pointer e;
+		position_type position;
+	};
+
+	// The events of a destructed context queued at the time, i.e. those
+	// numbered in [first, end). They are dropped only when they reach the
+	// front of the queue, and later events of a context constructed at the
+	// same address are not affected.
+	struct tombstone {
+		position_type first;
+		position_type end;
+	};
+
 	std::unordered_map<event::id_type, boost::signals2::signal<void(event::pointer)>> signals;
 
 	std::mutex queue_mutex;
-	/* ^ */ std::deque<event::pointer> queue;
+	/* ^ */ std::deque<queued_event> queue;
+	/* ^ */ position_type front_position; // of the next event queued at the front
+	/* ^ */ position_type back_position;  // of the next event queued at the back
+	/* ^ */ std::unordered_map<const slirc::irc*, std::vector<tombstone>> tombstones;
+	/* ^ */ std::size_t tombstone_count;
+	/* ^ */ std::size_t tombstones_pruned; // tombstone_count after pruning last
 	/* ^ */ std::vector<event_consumer_type> queue_consumers;
 	/* ^ */ std::vector<event_consumer_type>::size_type queue_consumer_index;
 
@@ -121,8 +127,110 @@ struct slirc::modules::event_manager::impl {
 	: signals()
 	, queue_mutex()
 	, queue()
+	, front_position((1ULL << 63) - 1)
+	, back_position(1ULL << 63)
+	, tombstones()
+	, tombstone_count(0)
+	, tombstones_pruned(0)
 	, queue_consumers()
 	, queue_consumer_index(0) {}
+
+	void push_back(event::pointer e) {
+		// requires: queue_mutex is locked!
+		queue.push_back(queued_event{ std::move(e), back_position++ });
+	}
+
+	void push_front(event::pointer e) {
+		// requires: queue_mutex is locked!
+		queue.push_front(queued_event{ std::move(e), front_position-- });
+	}
+
+	// drops the events of destructed contexts from the front of the queue;
+	// returns whether an event is left
+	bool skip_discarded() {
+		// requires: queue_mutex is locked!
+		while(!queue.empty()) {
+			if (tombstones.empty() || !is_discarded(queue.front())) {
+				return true;
+			}
+			queue.pop_front();
+		}
+		tombstones.clear(); // nothing left to discard
+		tombstone_count = tombstones_pruned = 0;
+		return false;
+	}
+
+	// requires: queue_mutex is locked, and skip_discarded() returned true!
+	event::pointer pop_front() {
+		event::pointer e = std::move(queue.front().e);
+		queue.pop_front();
+		return e;
+	}
+
+	void discard(const slirc::irc &context) {
+		// requires: queue_mutex is locked!
+		if (queue.empty()) {
+			return;
+		}
+		tombstones[&context].push_back(tombstone{ front_position + 1, back_position });
+		++tombstone_count;
+
+		// tombstones of contexts without queued events are only found by
+		// looking, which is done rarely enough to cost O(1) per tombstone
+		if (2 * tombstones_pruned + 16 < tombstone_count) {
+			prune_tombstones();
+		}
+	}
+
+	void try_unqueue() {
+		// requires: queue_mutex is locked!
+		while(queue_consumer_index < queue_consumers.size() && skip_discarded()) {
+			if (queue_consumers[queue_consumer_index++](queue.front().e)) {
+				// event is taken and being handled
+				queue.pop_front();
+			}
+		}
+
+		if (queue_consumer_index && queue_consumer_index == queue_consumers.size()) {
+			queue_consumers.resize(queue_consumer_index = 0);
+		}
+	}
+
+private:
+	bool is_discarded(const queued_event &queued) const {
+		auto it = tombstones.find(&queued.e->irc);
+		if (it != tombstones.end()) {
+			for(const tombstone &t : it->second) {
+				if (t.first <= queued.position && queued.position < t.end) {
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	void prune_tombstones() {
+		// a tombstone is done with once none of its events is queued
+		for(auto it = tombstones.begin(); it != tombstones.end(); ) {
+			auto &context_tombstones = it->second;
+			context_tombstones.erase(
+				std::remove_if(context_tombstones.begin(), context_tombstones.end(), [&](const tombstone &t) {
+					auto next = std::lower_bound(queue.begin(), queue.end(), t.first,
+						[](const queued_event &queued, position_type position) {
+							return queued.position < position;
+						});
+					return next == queue.end() || t.end <= next->position;
+				}),
+				context_tombstones.end());
+			it = context_tombstones.empty() ? tombstones.erase(it) : std::next(it);
+		}
+
+		tombstone_count = 0;
+		for(const auto &context_tombstones : tombstones) {
+			tombstone_count += context_tombstones.second.size();
+		}
+		tombstones_pruned = tombstone_count;
+	}
 };
 
 slirc::modules::event_manager::event_manager(slirc::irc &irc_)
@@ -162,11 +270,10 @@ void slirc::modules::event_manager::handle(event::pointer e) {
 	handle_afterwards *ha = e->components.find<handle_afterwards>();
 	if (ha) {
 		{ std::unique_lock<std::mutex> lock(impl_->queue_mutex);
-			std::copy(
-				ha->events.rbegin(), ha->events.rend(),
-				std::front_inserter(impl_->queue)
-			);
-			try_unqueue(impl_->queue, impl_->queue_consumers, impl_->queue_consumer_index);
+			for(auto it = ha->events.rbegin(); it != ha->events.rend(); ++it) {
+				impl_->push_front(*it);
+			}
+			impl_->try_unqueue();
 		}
 		e->components.remove<handle_afterwards>();
 	}
@@ -180,8 +287,8 @@ void slirc::modules::event_manager::handle_as(event::pointer e) {
 
 void slirc::modules::event_manager::queue(event::pointer e) {
 	{ std::unique_lock<std::mutex> queue_lock(impl_->queue_mutex);
-		impl_->queue.push_back(e);
-		try_unqueue(impl_->queue, impl_->queue_consumers, impl_->queue_consumer_index);
+		impl_->push_back(e);
+		impl_->try_unqueue();
 	}
 }
 
@@ -189,20 +296,16 @@ slirc::event::pointer slirc::modules::event_manager::wait_event() {
 	event::pointer ep;
 
 	{ std::unique_lock<std::mutex> queue_lock(impl_->queue_mutex);
-		if (!impl_->queue.empty()) {
-			ep = impl_->queue.front();
-			impl_->queue.pop_front();
-			return ep;
+		if (impl_->skip_discarded()) {
+			return impl_->pop_front();
 		}
 	}
 
 	auto data = prepare_returning_wait_event_data(ep);
 	{ std::unique_lock<std::mutex> data_lock(data->mutex);
 		{ std::unique_lock<std::mutex> queue_lock(impl_->queue_mutex);
-			if (!impl_->queue.empty()) {
-				ep = impl_->queue.front();
-				impl_->queue.pop_front();
-				return ep;
+			if (impl_->skip_discarded()) {
+				return impl_->pop_front();
 			}
 			impl_->queue_consumers.push_back(make_returning_wait_event_consumer(data));
 		}
@@ -217,20 +320,16 @@ slirc::event::pointer slirc::modules::event_manager::wait_event(std::chrono::mil
 	event::pointer ep;
 
 	{ std::unique_lock<std::mutex> queue_lock(impl_->queue_mutex);
-		if (!impl_->queue.empty()) {
-			ep = impl_->queue.front();
-			impl_->queue.pop_front();
-			return ep;
+		if (impl_->skip_discarded()) {
+			return impl_->pop_front();
 		}
 	}
 
 	auto data = prepare_returning_wait_event_data(ep);
 	{ std::unique_lock<std::mutex> data_lock(data->mutex);
 		{ std::unique_lock<std::mutex> queue_lock(impl_->queue_mutex);
-			if (!impl_->queue.empty()) {
-				ep = impl_->queue.front();
-				impl_->queue.pop_front();
-				return ep;
+			if (impl_->skip_discarded()) {
+				return impl_->pop_front();
 			}
 			impl_->queue_consumers.push_back(make_returning_wait_event_consumer(data));
 		}
@@ -247,8 +346,8 @@ slirc::event::pointer slirc::modules::event_manager::wait_event(std::chrono::mil
 
 void slirc::modules::event_manager::wait_event(event_consumer_type callback) {
 	{ std::unique_lock<std::mutex> lock(impl_->queue_mutex);
-		if (!impl_->queue.empty()) {
-			if (callback(impl_->queue.front())) {
+		if (impl_->skip_discarded()) {
+			if (callback(impl_->queue.front().e)) {
 				impl_->queue.pop_front();
 			}
 		}
@@ -258,6 +357,11 @@ void slirc::modules::event_manager::wait_event(event_consumer_type callback) {
 	}
 }
 
+void slirc::modules::event_manager::discard_events(const slirc::irc &context) {
+	std::unique_lock<std::mutex> lock(impl_->queue_mutex);
+	impl_->discard(context);
+}
+
 bool slirc::modules::event_manager::connection_less(
 	const disconnector_type &lhs,
 	const disconnector_type &rhs
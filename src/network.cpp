@@ -21,10 +21,20 @@
 ***************************************************************************/
 
 #include "../include/slirc/network.hpp"
+#include "../include/slirc/transport.hpp"
+#include "../include/slirc/detail/handshake_pool.hpp"
+#include "../include/slirc/detail/resolver.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <stdexcept>
+#include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #if __has_include(<optional>)
 #	include <optional>
@@ -38,9 +48,143 @@ using std::experimental::nullopt;
 #	error Neither std::optional nor std::experimental::optional are supported
 #endif
 
+#include <boost/asio/error.hpp>
 #include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
 
 namespace {
+	// declared before the network service, so it outlives the service's
+	// thread and thereby all pending lookups
+	struct slirc_resolver_cache {
+		typedef std::chrono::steady_clock clock;
+		typedef std::pair<std::string, unsigned> key_type;
+
+		struct entry {
+			entry()
+			: expires()
+			, error()
+			, endpoints()
+			, pending(false)
+			, waiting() {}
+
+			clock::time_point expires;
+			boost::system::error_code error;
+			std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+			bool pending; // a lookup is running
+			std::vector<slirc::network::detail::resolve_handler> waiting;
+		};
+
+		// expired entries are only removed on lookups once there are more
+		static constexpr std::size_t prune_threshold = 256;
+
+		slirc_resolver_cache()
+		: mutex()
+		, entries()
+		, ttl(std::chrono::seconds(60))
+		, negative_ttl(std::chrono::seconds(5)) {}
+
+		slirc_resolver_cache(const slirc_resolver_cache &) = delete;
+		slirc_resolver_cache& operator=(const slirc_resolver_cache &) = delete;
+
+		void prune(clock::time_point now) {
+			// assume: mutex locked!
+			for(auto it = entries.begin(); it != entries.end(); ) {
+				if (!it->second.pending && it->second.expires <= now) {
+					it = entries.erase(it);
+				}
+				else {
+					++it;
+				}
+			}
+		}
+
+		void finish(
+			const key_type &key,
+			const boost::system::error_code &error,
+			boost::asio::ip::tcp::resolver::iterator iterator
+		) {
+			std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+			for(; iterator != boost::asio::ip::tcp::resolver::iterator(); ++iterator) {
+				endpoints.push_back(*iterator);
+			}
+
+			std::vector<slirc::network::detail::resolve_handler> handlers;
+			{ std::unique_lock<std::mutex> lock(mutex);
+				entry &result = entries[key];
+				result.pending = false;
+				result.error = error;
+				result.endpoints = endpoints;
+				result.expires = clock::now() + (
+					(error == boost::asio::error::operation_aborted) ? clock::duration::zero() :
+					error ? negative_ttl : ttl
+				);
+				handlers.swap(result.waiting);
+			}
+
+			for(const auto &handler : handlers) {
+				handler(error, endpoints);
+			}
+		}
+
+		std::mutex mutex;
+			std::map<key_type, entry> entries;
+			clock::duration ttl;
+			clock::duration negative_ttl;
+	} resolver_cache;
+
+	// declared before the network service, so it outlives handshakes whose
+	// transport operations are still running on that service
+	struct slirc_handshake_pool {
+		struct pool {
+			explicit pool(unsigned thread_count)
+			: service()
+			, work()
+			, threads() {
+				work.emplace(service);
+				for(unsigned i=0; i<thread_count; ++i) {
+					threads.emplace_back([this]{ service.run(); });
+				}
+			}
+
+			pool(const pool &) = delete;
+			pool& operator=(const pool &) = delete;
+
+			boost::asio::io_service service;
+			optional<boost::asio::io_service::work> work;
+			std::vector<std::thread> threads;
+		};
+
+		slirc_handshake_pool()
+		: mutex()
+		, current()
+		, retired() {}
+
+		slirc_handshake_pool(const slirc_handshake_pool &) = delete;
+		slirc_handshake_pool& operator=(const slirc_handshake_pool &) = delete;
+
+		~slirc_handshake_pool() {
+			retire();
+			for(const auto &old : retired) {
+				for(auto &thread : old->threads) {
+					thread.join();
+				}
+			}
+		}
+
+		void retire() {
+			// assume: mutex locked (or destruction)!
+			if (current) {
+				// the threads end once running handshakes are done
+				current->work = nullopt;
+				retired.push_back(std::move(current));
+			}
+		}
+
+		std::mutex mutex;
+			std::unique_ptr<pool> current;
+			std::vector<std::unique_ptr<pool>> retired; // kept until unloading
+	} handshake_pool;
+
 	struct slirc_network_service {
 		slirc_network_service()
 		: service_mutex()
@@ -107,6 +251,86 @@ bool slirc::network::uses_internal_service() {
 	return network_service.current_service == &network_service.internal_service;
 }
 
+void slirc::network::detail::resolve(const std::string &host, unsigned port, resolve_handler handler) {
+	typedef slirc_resolver_cache::clock clock;
+	const slirc_resolver_cache::key_type key(host, port);
+	boost::asio::io_service &service = slirc::network::service();
+
+	std::unique_lock<std::mutex> lock(resolver_cache.mutex);
+	const clock::time_point now = clock::now();
+	if (slirc_resolver_cache::prune_threshold < resolver_cache.entries.size()) {
+		resolver_cache.prune(now);
+	}
+
+	slirc_resolver_cache::entry &cached = resolver_cache.entries[key];
+	if (!cached.pending && now < cached.expires) {
+		// always call back asynchronously, like a lookup would
+		service.post([handler, error=cached.error, endpoints=cached.endpoints]{
+			handler(error, endpoints);
+		});
+		return;
+	}
+
+	cached.waiting.push_back(std::move(handler));
+	if (cached.pending) {
+		return; // coalesced into the running lookup
+	}
+	cached.pending = true;
+	lock.unlock();
+
+	const auto resolver = std::make_shared<boost::asio::ip::tcp::resolver>(service);
+	resolver->async_resolve(
+		boost::asio::ip::tcp::resolver::query(host, std::to_string(port)),
+		[key, resolver](
+			const boost::system::error_code &error,
+			boost::asio::ip::tcp::resolver::iterator iterator
+		) {
+			resolver_cache.finish(key, error, iterator);
+		}
+	);
+}
+
+void slirc::network::set_resolver_cache_ttl(std::chrono::seconds ttl, std::chrono::seconds negative_ttl) {
+	std::unique_lock<std::mutex> lock(resolver_cache.mutex);
+	resolver_cache.ttl = ttl;
+	resolver_cache.negative_ttl = negative_ttl;
+}
+
+void slirc::network::clear_resolver_cache() {
+	std::unique_lock<std::mutex> lock(resolver_cache.mutex);
+	for(auto it = resolver_cache.entries.begin(); it != resolver_cache.entries.end(); ) {
+		if (it->second.pending) {
+			++it; // keep the waiting handlers
+		}
+		else {
+			it = resolver_cache.entries.erase(it);
+		}
+	}
+}
+
+void slirc::network::set_handshake_threads(unsigned threads) {
+	std::unique_lock<std::mutex> lock(handshake_pool.mutex);
+	const unsigned current = handshake_pool.current ? static_cast<unsigned>(handshake_pool.current->threads.size()) : 0;
+	if (threads == current) {
+		return;
+	}
+
+	handshake_pool.retire();
+	if (threads) {
+		handshake_pool.current.reset(new slirc_handshake_pool::pool(threads));
+	}
+}
+
+unsigned slirc::network::handshake_threads() {
+	std::unique_lock<std::mutex> lock(handshake_pool.mutex);
+	return handshake_pool.current ? static_cast<unsigned>(handshake_pool.current->threads.size()) : 0;
+}
+
+boost::asio::io_service *slirc::network::detail::handshake_service() {
+	std::unique_lock<std::mutex> lock(handshake_pool.mutex);
+	return handshake_pool.current ? &handshake_pool.current->service : nullptr;
+}
+
 bool slirc::network::has_ssl_support() {
 #ifdef SLIRC_BUILD_NO_SSL
 	return false;
@@ -114,3 +338,118 @@ bool slirc::network::has_ssl_support() {
 	return true;
 #endif
 }
+
+
+
+slirc::network::memory_pipe::memory_pipe(sink written_)
+: mutex()
+, written(std::move(written_))
+, buffered()
+, reading()
+, read_handler()
+, ended(false)
+, closed(false) {}
+
+void slirc::network::memory_pipe::feed(const char *data, std::size_t length) {
+	std::unique_lock<std::mutex> lock(mutex);
+	if (closed || ended || !length) {
+		return;
+	}
+
+	if (!read_handler) {
+		buffered.append(data, length);
+		return;
+	}
+
+	// straight into the buffers of the pending read
+	std::size_t copied = 0;
+	for(const auto &buffer : reading) {
+		const std::size_t part = std::min(boost::asio::buffer_size(buffer), length - copied);
+		std::memcpy(boost::asio::buffer_cast<char*>(buffer), data + copied, part);
+		copied += part;
+	}
+	buffered.append(data + copied, length - copied);
+
+	handler completed(std::move(read_handler));
+	read_handler = nullptr;
+	lock.unlock();
+	completed(boost::system::error_code(), copied);
+}
+
+void slirc::network::memory_pipe::end() {
+	std::unique_lock<std::mutex> lock(mutex);
+	ended = true;
+	if (!read_handler) {
+		return; // the next read finds the end
+	}
+
+	handler completed(std::move(read_handler));
+	read_handler = nullptr;
+	lock.unlock();
+	completed(boost::asio::error::eof, 0);
+}
+
+void slirc::network::memory_pipe::async_read_some(const read_buffers &buffers, handler handler) {
+	std::unique_lock<std::mutex> lock(mutex);
+	boost::system::error_code error;
+	std::size_t bytes_transferred = 0;
+	if (closed) {
+		error = boost::asio::error::operation_aborted;
+	}
+	else if (!buffered.empty()) {
+		bytes_transferred = take_buffered(buffers);
+	}
+	else if (ended) {
+		error = boost::asio::error::eof;
+	}
+	else {
+		reading = buffers;
+		read_handler = std::move(handler);
+		return; // completed by feed(), end() or close()
+	}
+
+	service().post([handler, error, bytes_transferred]{
+		handler(error, bytes_transferred);
+	});
+}
+
+void slirc::network::memory_pipe::async_write(const write_buffers &buffers, handler handler) {
+	std::size_t bytes_transferred = 0;
+	for(const auto &buffer : buffers) {
+		if (written) {
+			written(boost::asio::buffer_cast<const char*>(buffer), boost::asio::buffer_size(buffer));
+		}
+		bytes_transferred += boost::asio::buffer_size(buffer);
+	}
+
+	service().post([handler, bytes_transferred]{
+		handler(boost::system::error_code(), bytes_transferred);
+	});
+}
+
+void slirc::network::memory_pipe::close() {
+	std::unique_lock<std::mutex> lock(mutex);
+	closed = true;
+	buffered.clear();
+	if (!read_handler) {
+		return;
+	}
+
+	handler aborted(std::move(read_handler));
+	read_handler = nullptr;
+	service().post([aborted]{
+		aborted(boost::asio::error::operation_aborted, 0);
+	});
+}
+
+std::size_t slirc::network::memory_pipe::take_buffered(const read_buffers &buffers) {
+	// assumes mutex to be locked!
+	std::size_t taken = 0;
+	for(const auto &buffer : buffers) {
+		const std::size_t part = std::min(boost::asio::buffer_size(buffer), buffered.size() - taken);
+		std::memcpy(boost::asio::buffer_cast<char*>(buffer), buffered.data() + taken, part);
+		taken += part;
+	}
+	buffered.erase(0, taken);
+	return taken;
+}
@@ -0,0 +1,166 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#include "../../include/slirc/util/line_scanner.hpp"
+
+#include <cstring>
+
+#undef SLIRC_LINE_SCANNER_X86
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#	define SLIRC_LINE_SCANNER_X86
+#	include <immintrin.h>
+#endif
+
+namespace {
+	typedef std::size_t (*index_lines_function)(
+		const char *, std::size_t, std::vector<slirc::util::line_span> &, std::size_t);
+
+	inline void add_line(
+		const char *data,
+		std::vector<slirc::util::line_span> &lines,
+		std::size_t &line_begin,
+		std::size_t line_break
+	) {
+		std::size_t line_end = line_break;
+		if (line_begin < line_end && data[line_end-1] == '\r') {
+			--line_end;
+		}
+		lines.push_back(slirc::util::line_span{ line_begin, line_end - line_begin });
+		line_begin = line_break + 1;
+	}
+
+	std::size_t index_lines_scalar(
+		const char *data, std::size_t size,
+		std::vector<slirc::util::line_span> &lines,
+		std::size_t pos
+	) {
+		std::size_t line_begin = 0;
+		while(pos < size) {
+			const char *line_break = static_cast<const char*>(
+				std::memchr(data + pos, '\n', size - pos));
+			if (!line_break) break;
+
+			pos = line_break - data;
+			add_line(data, lines, line_begin, pos);
+			++pos;
+		}
+		return line_begin;
+	}
+
+#ifdef SLIRC_LINE_SCANNER_X86
+	__attribute__((target("sse2")))
+	std::size_t index_lines_sse2(
+		const char *data, std::size_t size,
+		std::vector<slirc::util::line_span> &lines,
+		std::size_t pos
+	) {
+		std::size_t line_begin = 0;
+		const __m128i lf = _mm_set1_epi8('\n');
+
+		for(; pos + 16 <= size; pos += 16) {
+			const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+			unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, lf)));
+			while(mask) {
+				add_line(data, lines, line_begin, pos + __builtin_ctz(mask));
+				mask &= mask - 1;
+			}
+		}
+
+		for(; pos < size; ++pos) {
+			if (data[pos] == '\n') {
+				add_line(data, lines, line_begin, pos);
+			}
+		}
+		return line_begin;
+	}
+
+	__attribute__((target("avx2")))
+	std::size_t index_lines_avx2(
+		const char *data, std::size_t size,
+		std::vector<slirc::util::line_span> &lines,
+		std::size_t pos
+	) {
+		std::size_t line_begin = 0;
+		const __m256i lf = _mm256_set1_epi8('\n');
+
+		for(; pos + 32 <= size; pos += 32) {
+			const __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+			unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, lf)));
+			while(mask) {
+				add_line(data, lines, line_begin, pos + __builtin_ctz(mask));
+				mask &= mask - 1;
+			}
+		}
+
+		for(; pos < size; ++pos) {
+			if (data[pos] == '\n') {
+				add_line(data, lines, line_begin, pos);
+			}
+		}
+		return line_begin;
+	}
+#endif
+
+	struct index_lines_dispatch {
+		index_lines_function function;
+		const char *name;
+
+		index_lines_dispatch() {
+			// the last supported implementation is the fastest one
+			const auto implementations = slirc::util::detail::supported_index_lines_implementations();
+			function = implementations.back().function;
+			name = implementations.back().name;
+		}
+	};
+
+	const index_lines_dispatch &get_index_lines_dispatch() {
+		static const index_lines_dispatch dispatch;
+		return dispatch;
+	}
+}
+
+std::size_t slirc::util::index_lines(
+	const char *data, std::size_t size,
+	std::vector<line_span> &lines,
+	std::size_t scan_from
+) {
+	SLIRC_ASSERT( scan_from <= size && "must not start scanning past the end of the buffer" );
+	return get_index_lines_dispatch().function(data, size, lines, scan_from);
+}
+
+const char *slirc::util::index_lines_implementation() {
+	return get_index_lines_dispatch().name;
+}
+
+std::vector<slirc::util::detail::index_lines_implementation> slirc::util::detail::supported_index_lines_implementations() {
+	std::vector<index_lines_implementation> implementations{ { "scalar", &index_lines_scalar } };
+#ifdef SLIRC_LINE_SCANNER_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")) {
+		implementations.push_back({ "sse2", &index_lines_sse2 });
+	}
+	if (__builtin_cpu_supports("avx2")) {
+		implementations.push_back({ "avx2", &index_lines_avx2 });
+	}
+#endif
+	return implementations;
+}
@@ -0,0 +1,51 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+#pragma once
+
+#ifndef SLIRC_TEST_EVENT_LOOP_HPP_INCLUDED
+#define SLIRC_TEST_EVENT_LOOP_HPP_INCLUDED
+
+#include <chrono>
+
+#include "../include/slirc/irc.hpp"
+#include "../include/slirc/apis/event_manager.hpp"
+
+namespace slirc { namespace test {
+	/* Handles the events of an irc context until the condition holds.
+	 * Returns false if it does not within ten seconds.
+	 */
+	template<typename Condition>
+	bool handle_events_until(slirc::irc &irc, Condition &&condition) {
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+		while(!condition()) {
+			if (deadline < std::chrono::steady_clock::now()) {
+				return false;
+			}
+			if (auto e = irc.event_manager().wait_event(std::chrono::milliseconds(10))) {
+				e->handle();
+			}
+		}
+		return true;
+	}
+}}
+
+#endif // SLIRC_TEST_EVENT_LOOP_HPP_INCLUDED
@@ -0,0 +1,316 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#pragma once
+
+#ifndef SLIRC_TEST_IRC_SERVER_HPP_INCLUDED
+#define SLIRC_TEST_IRC_SERVER_HPP_INCLUDED
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <boost/asio/generic/stream_protocol.hpp>
+#include <boost/asio/io_service.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+#include <boost/asio/write.hpp>
+
+namespace slirc { namespace test {
+	/* A scriptable IRC server stand-in: it listens on the loopback
+	 * interface, registers clients sending NICK and USER, answers their
+	 * PINGs and otherwise sends whatever it is told to, e.g. one of the
+	 * traffic patterns below. It counts the lines it receives and can hand
+	 * them to a callback.
+	 *
+	 * It runs on its own thread and io_service, so it does not compete with
+	 * the client for slirc::network::service().
+	 *
+	 * Given a path, it listens on a Unix domain socket as well; a path
+	 * starting with '@' is in the abstract namespace. A socket file is
+	 * replaced if it exists and removed again on destruction.
+	 */
+	class irc_server {
+	public:
+		typedef std::function<void(const std::string &line)> line_handler;
+
+		explicit irc_server(const std::string &name = "stand-in", const std::string &local_path = std::string())
+		: lines_received(0)
+		, bytes_received(0)
+		, registrations(0)
+		, name(name)
+		, handler()
+		, acceptor(service, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0))
+		, local_path(local_path)
+		, local_acceptor()
+		, clients() {
+			accept_next(acceptor);
+			if (!local_path.empty()) {
+				const bool abstract = local_path[0] == '@';
+				if (!abstract) {
+					std::remove(local_path.c_str());
+				}
+				local_acceptor.reset(new boost::asio::local::stream_protocol::acceptor(service,
+					boost::asio::local::stream_protocol::endpoint(abstract ? std::string(1, '\0') + local_path.substr(1) : local_path)));
+				accept_next(*local_acceptor);
+			}
+			thread = std::thread([this]{ service.run(); });
+		}
+
+		~irc_server() {
+			service.stop();
+			thread.join();
+			if (!local_path.empty() && local_path[0] != '@') {
+				std::remove(local_path.c_str());
+			}
+		}
+
+		unsigned short port() const {
+			return acceptor.local_endpoint().port();
+		}
+
+		/* Sets a callback invoked on the server thread for every line
+		 * received, after the server handled it. Must be set before clients
+		 * connect.
+		 */
+		void on_line(line_handler new_handler) {
+			handler = std::move(new_handler);
+		}
+
+		/* Sends data to all registered clients. */
+		void send(std::string data) {
+			blast(std::move(data), 1);
+		}
+
+		/* Sends data count times to all registered clients. Repetitions
+		 * are packed into writes of about 64 KiB, so floods are limited by
+		 * the client rather than by the stand-in.
+		 */
+		void blast(const std::string &data, unsigned long long count) {
+			if (data.empty() || !count) return;
+
+			const unsigned long long per_block = std::max<std::size_t>(1, 65536 / data.size());
+			const auto repeat = [&](unsigned long long times) {
+				std::string result;
+				result.reserve(times * data.size());
+				for(unsigned long long i=0; i<times; ++i) {
+					result += data;
+				}
+				return std::make_shared<const std::string>(std::move(result));
+			};
+			const auto block = repeat(count < per_block ? 0 : per_block);
+			const auto rest = repeat(count % per_block);
+
+			service.post([this, block, rest, blocks = count / per_block]{
+				for(const auto &c : clients) {
+					if (!c->registered) continue;
+					if (blocks) c->queue(block, blocks);
+					if (!rest->empty()) c->queue(rest, 1);
+				}
+			});
+		}
+
+		/* Waits until the given number of clients has registered. */
+		bool wait_for_registrations(unsigned long long count, std::chrono::milliseconds timeout = std::chrono::seconds(10)) const {
+			const auto deadline = std::chrono::steady_clock::now() + timeout;
+			while(registrations < count) {
+				if (deadline < std::chrono::steady_clock::now()) {
+					return false;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+			return true;
+		}
+
+		/* count messages to a channel, from a rotating set of senders. */
+		static std::string privmsg_flood(const std::string &channel, unsigned count) {
+			std::string result;
+			for(unsigned i=0; i<count; ++i) {
+				const std::string user = "user" + std::to_string(i % 97);
+				result += ":" + user + "!" + user + "@host" + std::to_string(i % 97) + ".example.org PRIVMSG "
+					+ channel + " :message " + std::to_string(i) + " of a flood of PRIVMSGs\r\n";
+			}
+			return result;
+		}
+
+		/* count users joining a channel at once, as after a netsplit. */
+		static std::string netjoin(const std::string &channel, unsigned count) {
+			std::string result;
+			for(unsigned i=0; i<count; ++i) {
+				const std::string user = "split" + std::to_string(i);
+				result += ":" + user + "!~" + user + "@gateway/web/" + std::to_string(i) + " JOIN " + channel + "\r\n";
+			}
+			return result;
+		}
+
+		/* A NAMES reply for a channel with count users. */
+		static std::string names(const std::string &nick, const std::string &channel, unsigned count,
+			const std::string &name = "stand-in"
+		) {
+			std::string result;
+			const std::string prefix = ":" + name + " 353 " + nick + " = " + channel + " :";
+			std::string line = prefix;
+			for(unsigned i=0; i<count; ++i) {
+				const std::string user = (i % 10 ? "" : "@") + std::string("member") + std::to_string(i);
+				if (line.size() + user.size() > 400) {
+					result += line + "\r\n";
+					line = prefix;
+				}
+				if (line.size() != prefix.size()) line += ' ';
+				line += user;
+			}
+			result += line + "\r\n:" + name + " 366 " + nick + " " + channel + " :End of /NAMES list.\r\n";
+			return result;
+		}
+
+		std::atomic<unsigned long long> lines_received;
+		std::atomic<unsigned long long> bytes_received;
+		std::atomic<unsigned long long> registrations;
+
+	private:
+		struct client: std::enable_shared_from_this<client> {
+			typedef std::pair<std::shared_ptr<const std::string>, unsigned long long> repeated;
+
+			client(irc_server &server)
+			: server(server)
+			, socket(server.service)
+			, received()
+			, nick()
+			, registered(false)
+			, outbox()
+			, writing(false) {}
+
+			void serve() {
+				auto self = shared_from_this();
+				socket.async_read_some(boost::asio::buffer(buffer),
+					[self](const boost::system::error_code &error, std::size_t bytes_transferred) {
+						if (error) {
+							self->server.forget(self);
+							return;
+						}
+						self->server.bytes_received += bytes_transferred;
+						self->received.append(self->buffer, bytes_transferred);
+
+						std::string::size_type begin = 0, end;
+						while(std::string::npos != (end = self->received.find('\n', begin))) {
+							std::string line = self->received.substr(begin, end - begin);
+							if (!line.empty() && line.back() == '\r') line.pop_back();
+							begin = end + 1;
+							self->handle(line);
+						}
+						self->received.erase(0, begin);
+						self->serve();
+					});
+			}
+
+			void handle(const std::string &line) {
+				if (line.compare(0, 5, "NICK ") == 0) {
+					nick = line.substr(5);
+				}
+				else if (line.compare(0, 5, "USER ") == 0 && !nick.empty() && !registered) {
+					queue(std::make_shared<const std::string>(
+						":" + server.name + " 001 " + nick + " :Welcome to the stand-in, " + nick + "\r\n"), 1);
+					registered = true;
+					++server.registrations;
+				}
+				else if (line.compare(0, 5, "PING ") == 0) {
+					queue(std::make_shared<const std::string>(
+						":" + server.name + " PONG " + server.name + " " + line.substr(5) + "\r\n"), 1);
+				}
+				if (server.handler) {
+					server.handler(line);
+				}
+				// counted last, so whoever sees the count sees the handler's work
+				++server.lines_received;
+			}
+
+			void queue(std::shared_ptr<const std::string> data, unsigned long long count) {
+				outbox.emplace_back(std::move(data), count);
+				if (!writing) {
+					write_next();
+				}
+			}
+
+			void write_next() {
+				if (outbox.empty()) {
+					writing = false;
+					return;
+				}
+				writing = true;
+				auto data = outbox.front().first;
+				if (0 == --outbox.front().second) {
+					outbox.pop_front();
+				}
+
+				auto self = shared_from_this();
+				boost::asio::async_write(socket, boost::asio::buffer(*data),
+					[self, data](const boost::system::error_code &error, std::size_t) {
+						if (!error) self->write_next();
+					});
+			}
+
+			irc_server &server;
+			boost::asio::generic::stream_protocol::socket socket; // TCP or Unix domain
+			char buffer[65536];
+			std::string received;
+			std::string nick;
+			bool registered;
+			std::deque<repeated> outbox;
+			bool writing;
+		};
+
+		template<typename Acceptor>
+		void accept_next(Acceptor &from) {
+			auto next = std::make_shared<client>(*this);
+			from.async_accept(next->socket,
+				[this, &from, next](const boost::system::error_code &error) {
+					if (error) return;
+					accept_next(from);
+					clients.push_back(next);
+					next->serve();
+				});
+		}
+
+		void forget(const std::shared_ptr<client> &gone) {
+			clients.erase(std::remove(clients.begin(), clients.end(), gone), clients.end());
+		}
+
+		const std::string name;
+		line_handler handler;
+		boost::asio::io_service service;
+		boost::asio::ip::tcp::acceptor acceptor;
+		const std::string local_path;
+		std::unique_ptr<boost::asio::local::stream_protocol::acceptor> local_acceptor;
+		std::vector<std::shared_ptr<client>> clients; // only used on the server thread
+		std::thread thread;
+	};
+}}
+
+#endif // SLIRC_TEST_IRC_SERVER_HPP_INCLUDED
@@ -331,3 +331,192 @@ SCENARIO("component_container - at_or_insert<T,U>", "") {
 		}
 	}
 }
+
+struct component_recyclable: slirc::component<component_recyclable> {
+	SLIRC_RECYCLABLE_COMPONENT(component_recyclable);
+
+	std::string text;
+	std::vector<int> values;
+	void reset() { text.clear(); values.clear(); }
+};
+struct component_recyclable_derived: component_recyclable {};
+
+struct component_recyclable_storage_only: slirc::component<component_recyclable_storage_only> {
+	SLIRC_RECYCLABLE_COMPONENT(component_recyclable_storage_only);
+
+	static int instances;
+
+	component_recyclable_storage_only() { ++instances; }
+	component_recyclable_storage_only(component_recyclable_storage_only &&) { ++instances; }
+	~component_recyclable_storage_only() { --instances; }
+};
+int component_recyclable_storage_only::instances = 0;
+
+TEST_CASE("eligibility of components for recycling - detail::is_recyclable_component", "") {
+	REQUIRE_FALSE(slirc::detail::is_recyclable_component<component_a>());
+	REQUIRE(slirc::detail::is_recyclable_component<component_recyclable>());
+	REQUIRE_FALSE(slirc::detail::is_recyclable_component<component_recyclable_derived>());
+	REQUIRE(slirc::detail::is_recyclable_component<component_recyclable_storage_only>());
+}
+
+SCENARIO("component_container - recycling components", "") {
+	GIVEN("an empty container and an empty pool") {
+		slirc::component_container cc;
+		slirc::component_container::set_recycling_limit<component_recyclable>(0);
+		slirc::component_container::set_recycling_limit<component_recyclable>(256);
+
+		WHEN("inserting and removing a recyclable component with a reset hook") {
+			component_recyclable *first = &cc.insert(component_recyclable());
+			first->text.assign(1000, 'x');
+			first->values.assign(1000, 1);
+			const auto capacity = first->text.capacity();
+			const auto values_capacity = first->values.capacity();
+			REQUIRE(cc.remove<component_recyclable>());
+
+			THEN("the instance is kept in the pool") {
+				REQUIRE(slirc::detail::component_pool<component_recyclable>::size() == 1);
+			}
+
+			THEN("the next insertion reuses the reset instance including its capacity") {
+				component_recyclable *second = &cc.insert(component_recyclable());
+				REQUIRE(second == first);
+				REQUIRE(second->text.empty());
+				REQUIRE(second->text.capacity() == capacity);
+				REQUIRE(second->values.empty());
+				REQUIRE(second->values.capacity() == values_capacity);
+				REQUIRE(slirc::detail::component_pool<component_recyclable>::size() == 0);
+			}
+
+			THEN("the next insertion takes over the inserted value") {
+				component_recyclable value;
+				value.text = "recycled";
+				value.values = { 1, 2, 3 };
+				component_recyclable *second = &cc.insert(std::move(value));
+				REQUIRE(second == first);
+				REQUIRE(second->text == "recycled");
+				REQUIRE(second->values == std::vector<int>({ 1, 2, 3 }));
+				REQUIRE(second->values.capacity() == values_capacity);
+			}
+
+			THEN("lowering the limit frees the idle instance") {
+				slirc::component_container::set_recycling_limit<component_recyclable>(0);
+				REQUIRE(slirc::detail::component_pool<component_recyclable>::size() == 0);
+			}
+		}
+
+		WHEN("destroying a container holding a recyclable component") {
+			{ slirc::component_container cc2;
+				cc2.insert(component_recyclable());
+			}
+
+			THEN("the instance is returned to the pool") {
+				REQUIRE(slirc::detail::component_pool<component_recyclable>::size() == 1);
+			}
+		}
+
+		WHEN("inserting and removing a derived component of a recyclable base") {
+			cc.insert(component_recyclable_derived());
+			REQUIRE(cc.remove<component_recyclable>());
+
+			THEN("the instance is not returned to the pool") {
+				REQUIRE(slirc::detail::component_pool<component_recyclable>::size() == 0);
+			}
+		}
+
+		WHEN("inserting and removing a recyclable component without a reset hook") {
+			REQUIRE(component_recyclable_storage_only::instances == 0);
+			cc.insert(component_recyclable_storage_only());
+			REQUIRE(cc.remove<component_recyclable_storage_only>());
+
+			THEN("the instance is destroyed, but its storage is kept in the pool") {
+				REQUIRE(component_recyclable_storage_only::instances == 0);
+				REQUIRE(slirc::detail::component_pool<component_recyclable_storage_only>::size() == 1);
+			}
+		}
+	}
+}
+
+SCENARIO("component_container - transferring components", "") {
+	GIVEN("a container with components A and B and an empty container") {
+		slirc::component_container source, target;
+		component_a *a = &source.insert(component_a());
+		component_b *b = &source.insert(component_b());
+
+		WHEN("transferring all components") {
+			REQUIRE_NOTHROW(source.transfer_to(target));
+
+			THEN("the source container is empty") {
+				REQUIRE_FALSE(source.has<component_a>());
+				REQUIRE_FALSE(source.has<component_b>());
+			}
+
+			THEN("the target container holds the very same component objects") {
+				REQUIRE(target.find<component_a>() == a);
+				REQUIRE(target.find<component_b>() == b);
+			}
+		}
+
+		WHEN("moving only component A") {
+			REQUIRE(source.move<component_a>(target) == 1);
+
+			THEN("component A is moved without being reconstructed") {
+				REQUIRE_FALSE(source.has<component_a>());
+				REQUIRE(target.find<component_a>() == a);
+			}
+
+			THEN("component B stays in the source container") {
+				REQUIRE(source.find<component_b>() == b);
+				REQUIRE_FALSE(target.has<component_b>());
+			}
+		}
+
+		WHEN("moving a component more than once in the same call") {
+			REQUIRE(source.move<component_a, component_a>(target) == 1);
+
+			THEN("it is only moved once") {
+				REQUIRE(target.find<component_a>() == a);
+			}
+		}
+
+		WHEN("moving components including one that is not present") {
+			REQUIRE(source.move<component_inherit_base, component_b>(target) == 1);
+
+			THEN("the missing component is skipped") {
+				REQUIRE(target.find<component_b>() == b);
+				REQUIRE_FALSE(target.has<component_inherit_base>());
+			}
+		}
+
+		WHEN("the target already contains a conflicting component") {
+			target.insert(component_b());
+
+			THEN("transferring all components fails without moving anything") {
+				REQUIRE_THROWS_AS(source.transfer_to(target), slirc::exceptions::component_conflict);
+				REQUIRE(source.find<component_a>() == a);
+				REQUIRE(source.find<component_b>() == b);
+				REQUIRE_FALSE(target.has<component_a>());
+			}
+
+			THEN("moving the conflicting component fails without moving anything") {
+				REQUIRE_THROWS_AS((source.move<component_a, component_b>(target)), slirc::exceptions::component_conflict);
+				REQUIRE(source.find<component_a>() == a);
+				REQUIRE_FALSE(target.has<component_a>());
+			}
+		}
+	}
+
+	GIVEN("a container with a derived component") {
+		slirc::component_container source, target;
+		source.insert(component_inherit_derived_a());
+
+		THEN("moving it as an unrelated derived component fails") {
+			REQUIRE_THROWS_AS(source.move<component_inherit_derived_b>(target), slirc::exceptions::component_conflict);
+			REQUIRE(source.has<component_inherit_derived_a>());
+		}
+
+		THEN("moving it by its base type keeps its dynamic type") {
+			REQUIRE(source.move<component_inherit_base>(target) == 1);
+			REQUIRE(target.has<component_inherit_derived_a>());
+		}
+	}
+}
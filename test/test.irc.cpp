@@ -22,6 +22,13 @@
 
 #include "testcase.hpp"
 
+#include <atomic>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
 #include "../include/slirc/component.hpp"
 #include "../include/slirc/irc.hpp"
 #include "../include/slirc/module.hpp"
@@ -179,6 +186,116 @@ SCENARIO("irc - module API", "") {
 }
 
 
+SCENARIO("irc - module handles", "") {
+	GIVEN("an irc context and a handle for a module that is not loaded") {
+		slirc::irc irc;
+		slirc::irc::handle<module_base> h(irc);
+
+		THEN("the handle does not refer to a module") {
+			REQUIRE_FALSE( h );
+			REQUIRE( h.get() == nullptr );
+			REQUIRE_THROWS_AS( *h, std::range_error );
+		}
+
+		WHEN("loading the module afterwards") {
+			module_base &mod = irc.load<module_base>();
+
+			THEN("the handle picks up the module") {
+				REQUIRE( h );
+				REQUIRE( h.get() == &mod );
+				REQUIRE( &*h == &mod );
+			}
+
+			AND_WHEN("unloading the module again") {
+				REQUIRE( h.get() == &mod );
+				REQUIRE( irc.unload<module_base>() );
+
+				THEN("the handle no longer refers to the module") {
+					REQUIRE_FALSE( h );
+					REQUIRE( h.get() == nullptr );
+				}
+			}
+
+			AND_WHEN("replacing the module with a derived module") {
+				REQUIRE( h.get() == &mod );
+				REQUIRE( irc.unload<module_base>() );
+				module_derived &mod2 = irc.load<module_derived>();
+
+				THEN("the handle refers to the new module") {
+					REQUIRE( h.get() == &mod2 );
+				}
+			}
+		}
+	}
+
+	GIVEN("an irc context with a base module loaded") {
+		slirc::irc irc;
+		irc.load<module_base>();
+
+		THEN("a handle for a derived module does not refer to it") {
+			slirc::irc::handle<module_derived> h(irc);
+			REQUIRE_FALSE( h );
+		}
+
+		THEN("handles in another irc context do not refer to it") {
+			slirc::irc other;
+			slirc::irc::handle<module_base> h(other);
+			REQUIRE_FALSE( h );
+		}
+	}
+
+	GIVEN("an irc context") {
+		slirc::irc irc;
+
+		THEN("a handle for the event manager refers to the event manager") {
+			slirc::irc::handle<slirc::apis::event_manager> h(irc);
+			REQUIRE( h.get() == &irc.event_manager() );
+		}
+	}
+
+	GIVEN("a handle that has not seen the module being loaded") {
+		slirc::irc irc;
+		slirc::irc::handle<module_base> h(irc);
+		module_base &mod = irc.load<module_base>();
+
+		WHEN("several threads use the handle at once") {
+			std::atomic<unsigned> found(0);
+			std::vector<std::thread> threads;
+			for(int i=0; i<4; ++i) {
+				threads.emplace_back([&]{
+					for(int j=0; j<10000; ++j) {
+						if (h.get() == &mod) ++found;
+					}
+				});
+			}
+			for(auto &thread : threads) {
+				thread.join();
+			}
+
+			THEN("all of them find the module") {
+				REQUIRE( found == 4*10000 );
+			}
+		}
+
+		WHEN("copying the handle") {
+			slirc::irc::handle<module_base> copy(h);
+
+			THEN("the copy finds the module") {
+				REQUIRE( copy.get() == &mod );
+			}
+
+			AND_WHEN("unloading the module") {
+				REQUIRE( irc.unload<module_base>() );
+
+				THEN("neither refers to it any more") {
+					REQUIRE_FALSE( copy );
+					REQUIRE_FALSE( h );
+				}
+			}
+		}
+	}
+}
+
 
 enum test_events {
 	test_event
@@ -210,3 +327,127 @@ SCENARIO("irc - event API", "") {
 		}
 	}
 }
+
+SCENARIO("irc - lightweight contexts", "") {
+	GIVEN("an irc context and a lightweight context sharing its event manager") {
+		slirc::irc host;
+		slirc::irc lightweight(host.event_manager());
+
+		THEN("the lightweight context uses the shared event manager") {
+			REQUIRE( &lightweight.event_manager() == &host.event_manager() );
+		}
+
+		THEN("the lightweight context does not have an event manager module of its own") {
+			REQUIRE_FALSE( lightweight.find<slirc::apis::event_manager>() );
+		}
+
+		WHEN("queuing an event of the lightweight context") {
+			lightweight.make_event(test_event)->queue();
+
+			THEN("it is received through the shared event manager, tagged with its context") {
+				slirc::event::pointer e = host.event_manager().wait_event(std::chrono::milliseconds(0));
+				REQUIRE( e );
+				REQUIRE( &e->irc == &lightweight );
+			}
+		}
+
+		WHEN("handling an event of the lightweight context") {
+			slirc::irc *handled_in = nullptr;
+			host.event_manager().connect(test_event, [&](slirc::event::pointer e) {
+				handled_in = &e->irc;
+			});
+			lightweight.make_event(test_event)->handle();
+
+			THEN("handlers connected to the shared event manager are invoked") {
+				REQUIRE( handled_in == &lightweight );
+			}
+		}
+
+		WHEN("loading and unloading an event manager into the lightweight context") {
+			slirc::modules::event_manager &own = lightweight.load<slirc::modules::event_manager>();
+
+			THEN("the loaded event manager takes precedence") {
+				REQUIRE( &lightweight.event_manager() == &own );
+			}
+
+			REQUIRE( lightweight.unload<slirc::modules::event_manager>() );
+
+			THEN("the shared event manager is used again after unloading") {
+				REQUIRE( &lightweight.event_manager() == &host.event_manager() );
+			}
+		}
+	}
+
+	GIVEN("an irc context and a lightweight context with queued events") {
+		slirc::irc host;
+		std::unique_ptr<slirc::irc> lightweight(new slirc::irc(host.event_manager()));
+		lightweight->make_event(test_event)->queue();
+		host.make_event(test_event)->queue();
+		lightweight->make_event(test_event)->queue();
+
+		WHEN("destructing the lightweight context") {
+			lightweight.reset();
+
+			THEN("its events are discarded, while the other events are kept") {
+				slirc::event::pointer e = host.event_manager().wait_event(std::chrono::milliseconds(0));
+				REQUIRE( e );
+				REQUIRE( &e->irc == &host );
+				REQUIRE_FALSE( host.event_manager().wait_event(std::chrono::milliseconds(0)) );
+			}
+		}
+	}
+
+	GIVEN("many lightweight contexts destructed while events stay queued") {
+		slirc::irc host;
+		host.make_event(test_event)->queue();
+		std::vector<std::unique_ptr<slirc::irc>> kept;
+		for(int i=0; i<100; ++i) {
+			std::unique_ptr<slirc::irc> lightweight(new slirc::irc(host.event_manager()));
+			if (i % 2) {
+				lightweight->make_event(test_event)->queue();
+			}
+			if (i % 10 == 0) {
+				kept.push_back(std::move(lightweight));
+				kept.back()->make_event(test_event)->queue();
+			}
+		}
+
+		THEN("only the events of the remaining contexts are received, in order") {
+			slirc::event::pointer e = host.event_manager().wait_event(std::chrono::milliseconds(0));
+			REQUIRE( e );
+			REQUIRE( &e->irc == &host );
+			for(const auto &lightweight : kept) {
+				e = host.event_manager().wait_event(std::chrono::milliseconds(0));
+				REQUIRE( e );
+				REQUIRE( &e->irc == lightweight.get() );
+			}
+			REQUIRE_FALSE( host.event_manager().wait_event(std::chrono::milliseconds(0)) );
+		}
+	}
+
+	GIVEN("a lightweight context with queued events, destructed and constructed again at the same address") {
+		slirc::irc host;
+		std::aligned_storage<sizeof(slirc::irc), alignof(slirc::irc)>::type storage;
+		slirc::irc *lightweight = new(&storage) slirc::irc(host.event_manager());
+		lightweight->make_event(test_event)->queue();
+		host.make_event(test_event)->queue();
+		lightweight->~irc();
+
+		lightweight = new(&storage) slirc::irc(host.event_manager());
+		lightweight->make_event(test_event)->queue();
+		slirc::event::pointer parent = host.make_event(test_event);
+		parent->afterwards(lightweight->make_event(test_event)); // queued at the front
+		parent->handle();
+
+		THEN("only the events queued before the destruction are discarded") {
+			for(slirc::irc *context : { lightweight, &host, lightweight }) {
+				slirc::event::pointer e = host.event_manager().wait_event(std::chrono::milliseconds(0));
+				REQUIRE( e );
+				REQUIRE( &e->irc == context );
+			}
+			REQUIRE_FALSE( host.event_manager().wait_event(std::chrono::milliseconds(0)) );
+		}
+
+		lightweight->~irc();
+	}
+}
@@ -0,0 +1,894 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#include "testcase.hpp"
+#include "event_loop.hpp"
+#include "irc_server.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "../include/slirc/irc.hpp"
+#include "../include/slirc/network.hpp"
+#include "../include/slirc/transport.hpp"
+#include "../include/slirc/apis/event_manager.hpp"
+#include "../include/slirc/modules/connection.hpp"
+
+#include "../src/event.cpp"
+#include "../src/irc.cpp"
+#include "../src/network.cpp"
+#include "../src/modules/connection.cpp"
+#include "../src/modules/event_manager.cpp"
+#include "../src/util/line_scanner.cpp"
+
+namespace {
+	using slirc::test::handle_events_until;
+
+	// accepts connections and closes them right away, optionally after
+	// welcoming the client
+	class dropping_listener {
+	public:
+		explicit dropping_listener(bool welcome)
+		: acceptor(service, boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0))
+		, stopping(false) {
+			thread = std::thread([this, welcome]{
+				while(true) {
+					boost::asio::ip::tcp::socket socket(service);
+					boost::system::error_code ec;
+					acceptor.accept(socket, ec);
+					if (stopping || ec) return;
+
+					{ std::unique_lock<std::mutex> lock(mutex);
+						accepted.push_back(std::chrono::steady_clock::now());
+					}
+					if (welcome) {
+						boost::asio::write(socket, boost::asio::buffer(std::string(":dropper 001 tester :Welcome\r\n")), ec);
+					}
+					socket.close(ec);
+				}
+			});
+		}
+
+		~dropping_listener() {
+			// wake up the blocking accept
+			stopping = true;
+			boost::asio::ip::tcp::socket socket(service);
+			boost::system::error_code ec;
+			socket.connect(acceptor.local_endpoint(), ec);
+			thread.join();
+		}
+
+		unsigned short port() const {
+			return acceptor.local_endpoint().port();
+		}
+
+		std::vector<std::chrono::steady_clock::time_point> accepted_so_far() {
+			std::unique_lock<std::mutex> lock(mutex);
+			return accepted;
+		}
+
+	private:
+		boost::asio::io_service service;
+		boost::asio::ip::tcp::acceptor acceptor;
+		std::atomic<bool> stopping;
+		std::mutex mutex;
+		std::vector<std::chrono::steady_clock::time_point> accepted;
+		std::thread thread;
+	};
+
+	// a listener with a full accept queue, so that connection attempts to it
+	// hang as if its address was black-holed, like in the happy eyeballs bench
+	class black_hole {
+	public:
+		explicit black_hole(const boost::asio::ip::address &address)
+		: acceptor(service, boost::asio::ip::tcp::endpoint(address, 0))
+		, backlog() {
+			acceptor.listen(0);
+			backlog.reserve(8);
+			for(int i=0; i<8; ++i) {
+				backlog.emplace_back(service);
+				// the connect starts right away, although the service never runs
+				backlog.back().async_connect(acceptor.local_endpoint(), [](const boost::system::error_code &){});
+			}
+		}
+
+		boost::asio::ip::tcp::endpoint endpoint() const {
+			return acceptor.local_endpoint();
+		}
+
+	private:
+		boost::asio::io_service service;
+		boost::asio::ip::tcp::acceptor acceptor;
+		std::vector<boost::asio::ip::tcp::socket> backlog;
+	};
+
+	// makes the host name resolve to the endpoints, in this order, without
+	// asking the system resolver
+	void seed_resolver(const std::string &host, unsigned port, std::vector<boost::asio::ip::tcp::endpoint> endpoints) {
+		std::unique_lock<std::mutex> lock(resolver_cache.mutex);
+		auto &entry = resolver_cache.entries[slirc_resolver_cache::key_type(host, port)];
+		entry.error = boost::system::error_code();
+		entry.endpoints = std::move(endpoints);
+		entry.expires = slirc_resolver_cache::clock::now() + std::chrono::hours(1);
+	}
+}
+
+SCENARIO("modules::connection - talking to a server", "") {
+	GIVEN("a connection with a registration burst and a server stand-in") {
+		slirc::test::irc_server server;
+		std::mutex server_lines_mutex;
+		std::vector<std::string> server_lines;
+		server.on_line([&](const std::string &line){
+			std::unique_lock<std::mutex> lock(server_lines_mutex);
+			server_lines.push_back(line);
+		});
+		const auto last_server_line = [&]{
+			std::unique_lock<std::mutex> lock(server_lines_mutex);
+			return server_lines.empty() ? std::string() : server_lines.back();
+		};
+
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+		connection.set_registration("NICK tester\r\nUSER tester 0 * :Tester\r\n");
+
+		std::vector<std::string> lines;
+		irc.event_manager().connect(slirc::apis::connection::received_line, [&](slirc::event::pointer e){
+			lines.push_back(e->components.at<slirc::apis::connection::received_data>().data());
+		});
+
+		WHEN("connecting") {
+			connection.connect("irc://127.0.0.1", server.port());
+
+			THEN("the connection registers and receives the welcome") {
+				REQUIRE( server.wait_for_registrations(1) );
+				REQUIRE( handle_events_until(irc, [&]{ return !lines.empty(); }) );
+				REQUIRE( lines.front() == ":stand-in 001 tester :Welcome to the stand-in, tester" );
+			}
+
+			AND_WHEN("the server floods it") {
+				REQUIRE( server.wait_for_registrations(1) );
+				server.blast(slirc::test::irc_server::privmsg_flood("#test", 100), 50);
+
+				THEN("every line arrives as an event, in order") {
+					REQUIRE( handle_events_until(irc, [&]{ return lines.size() == 1 + 100*50; }) );
+					REQUIRE( lines[1] == ":user0!user0@host0.example.org PRIVMSG #test :message 0 of a flood of PRIVMSGs" );
+					REQUIRE( lines.back() == ":user2!user2@host2.example.org PRIVMSG #test :message 99 of a flood of PRIVMSGs" );
+					REQUIRE( connection.get_traffic_stats().lines_in == lines.size() );
+				}
+			}
+
+			AND_WHEN("answering PINGs in the connection") {
+				connection.set_keepalive(slirc::modules::connection::keepalive::answer);
+				REQUIRE( server.wait_for_registrations(1) );
+				REQUIRE( handle_events_until(irc, [&]{ return !lines.empty(); }) );
+				server.send("PING :keepalive\r\n:stand-in NOTICE tester :after\r\n");
+
+				THEN("the server gets the PONG and no event is raised for the PING") {
+					REQUIRE( handle_events_until(irc, [&]{ return lines.size() == 2; }) );
+					REQUIRE( lines.back() == ":stand-in NOTICE tester :after" );
+					REQUIRE( handle_events_until(irc, [&]{ return server.lines_received == 3; }) );
+					REQUIRE( last_server_line() == "PONG :keepalive" );
+				}
+			}
+
+			connection.disconnect();
+		}
+	}
+}
+
+SCENARIO("modules::connection - talking to a server over a Unix domain socket", "") {
+	GIVEN("a server stand-in listening on a Unix domain socket") {
+		const std::string path = "test.modules.connection.sock";
+		slirc::test::irc_server server("stand-in", path);
+
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+		connection.set_registration("NICK tester\r\nUSER tester 0 * :Tester\r\n");
+
+		std::vector<std::string> lines;
+		irc.event_manager().connect(slirc::apis::connection::received_line, [&](slirc::event::pointer e){
+			lines.push_back(e->components.at<slirc::apis::connection::received_data>().data());
+		});
+
+		WHEN("connecting to the socket") {
+			connection.connect("unix://" + path);
+
+			THEN("the connection registers and receives lines as over TCP") {
+				REQUIRE( server.wait_for_registrations(1) );
+				server.blast(slirc::test::irc_server::privmsg_flood("#test", 100), 10);
+				REQUIRE( handle_events_until(irc, [&]{ return lines.size() == 1 + 100*10; }) );
+				REQUIRE( lines.front() == ":stand-in 001 tester :Welcome to the stand-in, tester" );
+				REQUIRE( connection.get_traffic_stats().lines_in == lines.size() );
+			}
+
+			connection.disconnect();
+		}
+	}
+
+	GIVEN("a server stand-in listening in the abstract namespace") {
+		slirc::test::irc_server server("stand-in", "@slirc.test.modules.connection");
+
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+		connection.set_registration("NICK tester\r\nUSER tester 0 * :Tester\r\n");
+
+		WHEN("connecting to the socket") {
+			connection.connect("unix://@slirc.test.modules.connection");
+
+			THEN("the connection registers") {
+				REQUIRE( server.wait_for_registrations(1) );
+			}
+
+			connection.disconnect();
+		}
+	}
+}
+
+SCENARIO("modules::connection - capturing and replaying", "") {
+	GIVEN("a connection capturing what a server stand-in sends") {
+		const std::string path = "test.modules.connection.capture";
+
+		slirc::test::irc_server server;
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+		connection.set_registration("NICK tester\r\nUSER tester 0 * :Tester\r\n");
+
+		std::vector<std::string> lines;
+		irc.event_manager().connect(slirc::apis::connection::received_line, [&](slirc::event::pointer e){
+			lines.push_back(e->components.at<slirc::apis::connection::received_data>().data());
+		});
+
+		connection.start_capture(path);
+		connection.connect("irc://127.0.0.1", server.port());
+		REQUIRE( server.wait_for_registrations(1) );
+		server.blast(slirc::test::irc_server::netjoin("#test", 100), 20);
+		REQUIRE( handle_events_until(irc, [&]{ return lines.size() == 1 + 100*20; }) );
+		connection.disconnect();
+		connection.stop_capture();
+
+		WHEN("replaying the capture on another connection") {
+			slirc::irc replay_irc;
+			auto &replay = replay_irc.load<slirc::modules::connection>();
+
+			std::vector<std::string> replayed;
+			bool disconnected = false;
+			replay_irc.event_manager().connect(slirc::apis::connection::received_line, [&](slirc::event::pointer e){
+				replayed.push_back(e->components.at<slirc::apis::connection::received_data>().data());
+			});
+			replay_irc.event_manager().connect(slirc::apis::connection::state::disconnected, [&](slirc::event::pointer){
+				disconnected = true;
+			});
+
+			replay.replay(path);
+
+			THEN("the same lines are received, and the connection ends with the capture") {
+				REQUIRE( handle_events_until(replay_irc, [&]{ return disconnected; }) );
+				REQUIRE( replayed == lines );
+				REQUIRE( replay.get_traffic_stats().bytes_in == connection.get_traffic_stats().bytes_in );
+			}
+		}
+
+		WHEN("replaying something that is not a capture") {
+			std::FILE *file = std::fopen(path.c_str(), "wb");
+			std::fputs(":stand-in 001 tester :Welcome\r\n", file);
+			std::fclose(file);
+
+			THEN("replaying fails") {
+				REQUIRE_THROWS_AS( connection.replay(path), std::runtime_error );
+				REQUIRE_THROWS_AS( connection.replay(path + ".missing"), std::runtime_error );
+				REQUIRE( connection.current_state() == slirc::apis::connection::state::disconnected );
+			}
+		}
+
+		std::remove(path.c_str());
+	}
+}
+
+SCENARIO("modules::connection - a memory pipe as the transport", "") {
+	GIVEN("a connection attached to a memory pipe") {
+		std::mutex written_mutex;
+		std::string written;
+		auto pipe = std::make_shared<slirc::network::memory_pipe>([&](const char *data, std::size_t length){
+			std::unique_lock<std::mutex> lock(written_mutex);
+			written.append(data, length);
+		});
+		const auto written_so_far = [&]{
+			std::unique_lock<std::mutex> lock(written_mutex);
+			return written;
+		};
+
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+		connection.set_registration("NICK tester\r\nUSER tester 0 * :Tester\r\n");
+		connection.set_keepalive(slirc::modules::connection::keepalive::answer);
+		connection.set_reconnect_policy({ true, std::chrono::milliseconds(1), std::chrono::milliseconds(1), 1.0, 0.0 });
+
+		std::vector<std::string> lines;
+		bool disconnected = false, failed = false;
+		irc.event_manager().connect(slirc::apis::connection::received_line, [&](slirc::event::pointer e){
+			lines.push_back(e->components.at<slirc::apis::connection::received_data>().data());
+		});
+		irc.event_manager().connect(slirc::apis::connection::state::disconnected, [&](slirc::event::pointer){
+			disconnected = true;
+		});
+		irc.event_manager().connect(slirc::modules::connection::error, [&](slirc::event::pointer){
+			failed = true;
+		});
+
+		connection.connect(pipe);
+
+		THEN("the connection is connected and registers through the pipe") {
+			REQUIRE( connection.current_state() == slirc::apis::connection::state::connected );
+			REQUIRE( handle_events_until(irc, [&]{ return written_so_far() == "NICK tester\r\nUSER tester 0 * :Tester\r\n"; }) );
+			REQUIRE_THROWS_AS( connection.connect(pipe), slirc::exceptions::already_connected );
+		}
+
+		WHEN("feeding lines split across feeds") {
+			pipe->feed(":stand-in 001 tester :Wel");
+			pipe->feed("come\r\nPING :pipe\r\n:stand-in NOTICE tester :after\r\n");
+
+			THEN("the lines are received, and PINGs are answered") {
+				REQUIRE( handle_events_until(irc, [&]{ return lines.size() == 2; }) );
+				REQUIRE( lines[0] == ":stand-in 001 tester :Welcome" );
+				REQUIRE( lines[1] == ":stand-in NOTICE tester :after" );
+				REQUIRE( handle_events_until(irc, [&]{ return written_so_far().find("PONG :pipe\r\n") != std::string::npos; }) );
+				REQUIRE( connection.get_traffic_stats().lines_in == 3 );
+			}
+		}
+
+		WHEN("one thread corks the connection") {
+			std::unique_ptr<slirc::apis::connection::batch> batch(new slirc::apis::connection::batch(connection));
+			connection.send_raw("JOIN #a\r\n");
+			std::thread([&]{
+				connection.send_raw("JOIN #b\r\n");
+				pipe->feed("PING :corked\r\n");
+			}).join();
+
+			THEN("only its own data is held back") {
+				REQUIRE( handle_events_until(irc, [&]{ return written_so_far().find("PONG :corked\r\n") != std::string::npos; }) );
+				REQUIRE( written_so_far().find("JOIN #b\r\n") != std::string::npos );
+				REQUIRE( written_so_far().find("JOIN #a\r\n") == std::string::npos );
+
+				batch.reset();
+				REQUIRE( handle_events_until(irc, [&]{ return written_so_far().find("JOIN #a\r\n") != std::string::npos; }) );
+			}
+		}
+
+		WHEN("a PING arrives on a thread that has the connection corked") {
+			slirc::apis::connection::batch batch(connection);
+			connection.send_raw("JOIN #a\r\n");
+			pipe->feed("ping :lower\r\n");
+
+			THEN("the PONG is sent nonetheless") {
+				REQUIRE( handle_events_until(irc, [&]{ return written_so_far().find("PONG :lower\r\n") != std::string::npos; }) );
+				REQUIRE( written_so_far().find("JOIN #a\r\n") == std::string::npos );
+			}
+		}
+
+		WHEN("delivering both batches and lines") {
+			connection.set_line_delivery(slirc::modules::connection::line_delivery::lines_and_batches);
+			irc.event_manager().connect(slirc::apis::connection::received_lines, [&](slirc::event::pointer e){
+				const auto &batch = e->components.at<slirc::apis::connection::received_line_batch>();
+				lines.push_back("batch of " + std::to_string(batch.size()));
+			});
+			pipe->feed(":stand-in 001 tester :Welcome\r\n:stand-in NOTICE tester :after\r\n");
+
+			THEN("the line events are derived from the batch and follow it") {
+				REQUIRE( handle_events_until(irc, [&]{ return lines.size() == 3; }) );
+				REQUIRE( lines[0] == "batch of 2" );
+				REQUIRE( lines[1] == ":stand-in 001 tester :Welcome" );
+				REQUIRE( lines[2] == ":stand-in NOTICE tester :after" );
+			}
+		}
+
+		WHEN("delivering batches only") {
+			connection.set_line_delivery(slirc::modules::connection::line_delivery::batches);
+			std::size_t batched = 0;
+			irc.event_manager().connect(slirc::apis::connection::received_lines, [&](slirc::event::pointer e){
+				batched += e->components.at<slirc::apis::connection::received_line_batch>().size();
+			});
+			pipe->feed(":stand-in 001 tester :Welcome\r\n:stand-in NOTICE tester :after\r\n");
+
+			THEN("no line events are raised") {
+				REQUIRE( handle_events_until(irc, [&]{ return batched == 2; }) );
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				while(auto e = irc.event_manager().wait_event(std::chrono::milliseconds(10))) {
+					e->handle();
+				}
+				REQUIRE( lines.empty() );
+			}
+		}
+
+		WHEN("the pipe ends") {
+			pipe->feed(":stand-in 001 tester :Welcome\r\n");
+			pipe->end();
+
+			THEN("the connection is disconnected without an error, and not reconnected") {
+				REQUIRE( handle_events_until(irc, [&]{ return disconnected; }) );
+				REQUIRE( lines.size() == 1 );
+				REQUIRE( !failed );
+				std::this_thread::sleep_for(std::chrono::milliseconds(50)); // well past the reconnect delay
+				REQUIRE( connection.current_state() == slirc::apis::connection::state::disconnected );
+			}
+		}
+
+		connection.disconnect();
+	}
+}
+
+SCENARIO("modules::connection - receive buffering", "") {
+	GIVEN("a connection attached to a memory pipe") {
+		auto pipe = std::make_shared<slirc::network::memory_pipe>();
+
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+
+		std::vector<std::string> lines;
+		irc.event_manager().connect(slirc::apis::connection::received_line, [&](slirc::event::pointer e){
+			lines.push_back(e->components.at<slirc::apis::connection::received_data>().data());
+		});
+
+		connection.connect(pipe);
+		REQUIRE( connection.get_statistics().read_size == 512 );
+
+		WHEN("more data arrives than fits the read size") {
+			const std::string line = ":stand-in NOTICE tester :" + std::string(1973, 'x');
+			pipe->feed(line + "\r\n");
+
+			THEN("it is read in reads of the growing read size") {
+				REQUIRE( handle_events_until(irc, [&]{ return lines.size() == 1; }) );
+				REQUIRE( lines.front() == line );
+				// 512 and 1024 bytes, then the remaining 464 bytes, which
+				// are less than a quarter of the 2048 bytes asked for
+				REQUIRE( connection.get_statistics().reads == 3 );
+				REQUIRE( connection.get_statistics().read_size == 1024 );
+			}
+		}
+
+		WHEN("a burst arrives while the lines of earlier reads are still queued") {
+			// the pipe fills every read, so the read size doubles from 512
+			// to 64 KiB in 8 reads (130560 bytes), then stays there; the
+			// burst ends exactly with the third read of 64 KiB
+			const std::size_t burst_size = 130560 + 3*65536;
+			std::vector<std::string> expected;
+			std::string burst;
+			while(burst.size() < burst_size) {
+				std::string line = ":stand-in NOTICE tester :" + std::to_string(expected.size()) + " ";
+				// one line longer than a slab, the others of varying length
+				line.append(expected.size() == 500 ? 20000 : (expected.size() * 37) % 300, 'x');
+				if (burst_size - burst.size() < line.size() + 2 + 40) {
+					line.append(burst_size - burst.size() - line.size() - 2, 'y');
+				}
+				expected.push_back(line);
+				burst += line + "\r\n";
+			}
+			REQUIRE( burst.size() == burst_size );
+
+			// no event is handled before all data was read, so no slab is
+			// released by the lines handed out: lines straddle slab ends,
+			// are scattered into spill slabs and moved to fresh slabs
+			pipe->feed(burst);
+
+			THEN("every line arrives intact, and reads grow to 64 KiB") {
+				REQUIRE( handle_events_until(irc, [&]{ return lines.size() == expected.size(); }) );
+				REQUIRE( lines == expected );
+				REQUIRE( connection.get_statistics().bytes_in == burst_size );
+				REQUIRE( connection.get_statistics().reads == 11 );
+				REQUIRE( connection.get_statistics().read_size == 65536 );
+			}
+
+			AND_WHEN("single short lines follow, one at a time") {
+				REQUIRE( handle_events_until(irc, [&]{ return lines.size() == expected.size(); }) );
+				for(int i=0; i<8; ++i) {
+					pipe->feed(":stand-in NOTICE tester :short\r\n");
+					REQUIRE( handle_events_until(irc, [&]{ return lines.size() == expected.size() + i + 1; }) );
+				}
+
+				THEN("the read size shrinks back to 512 bytes") {
+					REQUIRE( lines.back() == ":stand-in NOTICE tester :short" );
+					REQUIRE( connection.get_statistics().read_size == 512 );
+				}
+			}
+		}
+
+		WHEN("a line is fed in pieces around a read boundary, with its start handled") {
+			pipe->feed(std::string(":stand-in NOTICE tester :first\r\n:stand-in NOTICE tester :") + std::string(470, 'a'));
+			REQUIRE( handle_events_until(irc, [&]{ return lines.size() == 1; }) );
+			pipe->feed(std::string(9000, 'b') + "\r\n:stand-in NOTICE tester :last\r\n");
+
+			THEN("the line is joined across the slabs") {
+				REQUIRE( handle_events_until(irc, [&]{ return lines.size() == 3; }) );
+				REQUIRE( lines[0] == ":stand-in NOTICE tester :first" );
+				REQUIRE( lines[1] == ":stand-in NOTICE tester :" + std::string(470, 'a') + std::string(9000, 'b') );
+				REQUIRE( lines[2] == ":stand-in NOTICE tester :last" );
+			}
+		}
+
+		connection.disconnect();
+	}
+}
+
+SCENARIO("modules::connection - lightweight contexts sharing an event manager", "") {
+	GIVEN("connections of several lightweight contexts sharing one event manager") {
+		slirc::irc host;
+		std::vector<std::unique_ptr<slirc::irc>> contexts;
+		std::vector<std::shared_ptr<slirc::network::memory_pipe>> pipes;
+		for(int i=0; i<3; ++i) {
+			contexts.emplace_back(new slirc::irc(host.event_manager()));
+			pipes.push_back(std::make_shared<slirc::network::memory_pipe>());
+			contexts.back()->load<slirc::modules::connection>().connect(pipes.back());
+		}
+
+		std::vector<std::pair<const slirc::irc*, std::string>> lines;
+		host.event_manager().connect(slirc::apis::connection::received_line, [&](slirc::event::pointer e){
+			lines.emplace_back(&e->irc, e->components.at<slirc::apis::connection::received_data>().data());
+		});
+
+		WHEN("each connection receives lines") {
+			for(int i=0; i<3; ++i) {
+				pipes[i]->feed(":stand-in NOTICE tester :" + std::to_string(i) + "a\r\n:stand-in NOTICE tester :" + std::to_string(i) + "b\r\n");
+			}
+
+			THEN("each line is raised once, by the context that received it") {
+				REQUIRE( handle_events_until(host, [&]{ return lines.size() == 6; }) );
+				for(int i=0; i<3; ++i) {
+					REQUIRE( std::count(lines.begin(), lines.end(),
+						std::make_pair<const slirc::irc*>(contexts[i].get(), ":stand-in NOTICE tester :" + std::to_string(i) + "a")) == 1 );
+					REQUIRE( std::count(lines.begin(), lines.end(),
+						std::make_pair<const slirc::irc*>(contexts[i].get(), ":stand-in NOTICE tester :" + std::to_string(i) + "b")) == 1 );
+				}
+			}
+		}
+
+		WHEN("the context that connected first is destroyed") {
+			contexts.front()->find<slirc::modules::connection>()->disconnect();
+			contexts.front().reset();
+			pipes[1]->feed(":stand-in NOTICE tester :still here\r\n");
+
+			THEN("the line events of the others are still raised") {
+				REQUIRE( handle_events_until(host, [&]{ return lines.size() == 1; }) );
+				REQUIRE( lines.front().first == contexts[1].get() );
+				REQUIRE( lines.front().second == ":stand-in NOTICE tester :still here" );
+			}
+		}
+
+		for(auto &context : contexts) {
+			if (context) {
+				context->find<slirc::modules::connection>()->disconnect();
+			}
+		}
+	}
+}
+
+SCENARIO("modules::connection - flood control", "") {
+	GIVEN("a connection with flood control attached to a memory pipe") {
+		typedef std::chrono::steady_clock clock;
+		typedef slirc::modules::connection::send_priority send_priority;
+
+		std::mutex written_mutex;
+		std::vector<std::string> written;
+		std::string partial;
+		auto pipe = std::make_shared<slirc::network::memory_pipe>([&](const char *data, std::size_t length){
+			std::unique_lock<std::mutex> lock(written_mutex);
+			partial.append(data, length);
+			for(std::string::size_type end; (end = partial.find("\r\n")) != std::string::npos; ) {
+				written.push_back(partial.substr(0, end));
+				partial.erase(0, end + 2);
+			}
+		});
+		const auto written_so_far = [&]{
+			std::unique_lock<std::mutex> lock(written_mutex);
+			return written;
+		};
+
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+
+		WHEN("sending more lines than the line bucket holds at once") {
+			// two lines at once, then one line per 200 ms
+			connection.set_flood_control({ 2, 0, std::chrono::milliseconds(400) });
+			connection.connect(pipe);
+			const auto sent_at = clock::now();
+			connection.send_raw("PONG :x\r\nPRIVMSG #a :1\r\nPRIVMSG #a :2\r\nPRIVMSG #a :3\r\n");
+
+			THEN("the lines behind the first one are charged and held back on their own") {
+				REQUIRE( handle_events_until(irc, [&]{ return written_so_far().size() == 2; }) );
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+				REQUIRE( written_so_far() == std::vector<std::string>({ "PONG :x", "PRIVMSG #a :1" }) );
+				REQUIRE( connection.get_statistics().sends[static_cast<std::size_t>(send_priority::bulk)].queued == 2 );
+
+				REQUIRE( handle_events_until(irc, [&]{ return written_so_far().size() == 4; }) );
+				REQUIRE( std::chrono::milliseconds(300) <= clock::now() - sent_at );
+				REQUIRE( written_so_far().back() == "PRIVMSG #a :3" );
+
+				const auto stats = connection.get_statistics();
+				REQUIRE( stats.sends[static_cast<std::size_t>(send_priority::immediate)].sent == 1 );
+				REQUIRE( stats.sends[static_cast<std::size_t>(send_priority::bulk)].sent == 3 );
+				REQUIRE( stats.sends[static_cast<std::size_t>(send_priority::bulk)].queued == 0 );
+			}
+		}
+
+		WHEN("sending more bytes than the byte bucket holds at once") {
+			connection.set_flood_control({ 0, 20, std::chrono::milliseconds(200) });
+			connection.connect(pipe);
+			connection.send_raw("PRIVMSG #a :1\r\nPRIVMSG #a :2\r\n"); // 15 bytes each
+
+			THEN("the second line waits for the bytes to be refilled") {
+				REQUIRE( handle_events_until(irc, [&]{ return written_so_far().size() == 1; }) );
+				std::this_thread::sleep_for(std::chrono::milliseconds(30));
+				REQUIRE( written_so_far().size() == 1 );
+				REQUIRE( handle_events_until(irc, [&]{ return written_so_far().size() == 2; }) );
+			}
+		}
+
+		WHEN("lines of all priorities are held back") {
+			connection.set_flood_control({ 1, 0, std::chrono::milliseconds(50) });
+			connection.connect(pipe);
+			connection.send_raw("PRIVMSG #a :1\r\nPRIVMSG #a :2\r\nJOIN #b\r\nPONG :x\r\nMODE #b +t\r\n");
+
+			THEN("immediate lines go first, then control lines, then bulk lines") {
+				REQUIRE( handle_events_until(irc, [&]{ return written_so_far().size() == 5; }) );
+				REQUIRE( written_so_far() == std::vector<std::string>({
+					"PONG :x", "JOIN #b", "MODE #b +t", "PRIVMSG #a :1", "PRIVMSG #a :2" }) );
+			}
+		}
+
+		WHEN("bulk lines for several targets are held back") {
+			connection.set_flood_control({ 1, 0, std::chrono::milliseconds(50) });
+			connection.connect(pipe);
+			connection.send_raw(
+				"PRIVMSG #a :1\r\nPRIVMSG #a :2\r\nPRIVMSG #a :3\r\n"
+				"PRIVMSG #B :1\r\nNOTICE nick :1\r\nprivmsg #b :2\r\n");
+
+			THEN("the targets take turns") {
+				REQUIRE( handle_events_until(irc, [&]{ return written_so_far().size() == 6; }) );
+				REQUIRE( written_so_far() == std::vector<std::string>({
+					"PRIVMSG #a :1", "PRIVMSG #B :1", "NOTICE nick :1",
+					"PRIVMSG #a :2", "privmsg #b :2", "PRIVMSG #a :3" }) );
+			}
+		}
+
+		WHEN("a line is sent in pieces") {
+			connection.set_flood_control({ 1, 0, std::chrono::milliseconds(50) });
+			connection.connect(pipe);
+			connection.send_raw("PRIVMSG #a :1\r\nPRIV");
+			connection.send_raw("MSG #a :2\r\nPO");
+			connection.send_raw("NG :x\r\n");
+
+			THEN("it is classified as a whole") {
+				REQUIRE( handle_events_until(irc, [&]{ return written_so_far().size() == 3; }) );
+				const auto stats = connection.get_statistics();
+				REQUIRE( stats.sends[static_cast<std::size_t>(send_priority::immediate)].sent == 1 );
+				REQUIRE( stats.sends[static_cast<std::size_t>(send_priority::bulk)].sent == 2 );
+			}
+		}
+
+		connection.disconnect();
+	}
+}
+
+SCENARIO("modules::connection - reconnecting", "") {
+	GIVEN("a connection reconnecting with a quickly growing backoff") {
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+		connection.set_registration("NICK tester\r\nUSER tester 0 * :Tester\r\n");
+		// without a reset, the delays are 20, 80, 320, ... ms
+		connection.set_reconnect_policy({ true, std::chrono::milliseconds(20), std::chrono::seconds(5), 4.0, 0.0 });
+
+		WHEN("the server accepts connections and drops them right away") {
+			dropping_listener server(false);
+			connection.connect("irc://127.0.0.1", server.port());
+
+			THEN("the backoff keeps growing") {
+				REQUIRE( handle_events_until(irc, [&]{ return server.accepted_so_far().size() == 4; }) );
+				const auto accepted = server.accepted_so_far();
+				REQUIRE( std::chrono::milliseconds(400) <= accepted[3] - accepted[0] );
+				REQUIRE( accepted[2] - accepted[1] < accepted[3] - accepted[2] );
+			}
+
+			connection.disconnect();
+		}
+
+		WHEN("the server welcomes the client before dropping it") {
+			dropping_listener server(true);
+			connection.connect("irc://127.0.0.1", server.port());
+
+			THEN("the backoff is reset after each session") {
+				REQUIRE( handle_events_until(irc, [&]{ return server.accepted_so_far().size() == 4; }) );
+				const auto accepted = server.accepted_so_far();
+				REQUIRE( accepted[3] - accepted[0] < std::chrono::milliseconds(300) );
+			}
+
+			connection.disconnect();
+		}
+	}
+}
+
+SCENARIO("modules::connection - racing the addresses of a host name", "") {
+	GIVEN("a host name resolving to two black-holed IPv6 addresses and a live IPv4 one") {
+		typedef std::chrono::steady_clock clock;
+
+		slirc::test::irc_server server;
+		black_hole first(boost::asio::ip::address_v6::loopback());
+		black_hole second(boost::asio::ip::address_v6::loopback());
+		seed_resolver("eyeballs.invalid", server.port(), {
+			first.endpoint(),
+			second.endpoint(),
+			boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), server.port())
+		});
+
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+		connection.set_registration("NICK tester\r\nUSER tester 0 * :Tester\r\n");
+
+		unsigned errors = 0;
+		irc.event_manager().connect(slirc::modules::connection::error, [&](slirc::event::pointer){
+			++errors;
+		});
+		unsigned connects = 0;
+		clock::time_point connected_at;
+		irc.event_manager().connect(slirc::apis::connection::state::connected, [&](slirc::event::pointer){
+			++connects;
+			connected_at = clock::now();
+		});
+
+		const auto handle_events_for = [&](clock::duration duration) {
+			const auto until = clock::now() + duration;
+			handle_events_until(irc, [&]{ return until <= clock::now(); });
+		};
+
+		WHEN("connecting") {
+			const auto started = clock::now();
+			connection.connect("irc://eyeballs.invalid", server.port());
+
+			THEN("the IPv4 address is tried second, one attempt delay in, and wins well before a connect timeout") {
+				REQUIRE( handle_events_until(irc, [&]{ return connects == 1; }) );
+				REQUIRE( std::chrono::milliseconds(250) <= connected_at - started );
+				REQUIRE( connected_at - started < std::chrono::milliseconds(500) );
+				REQUIRE( server.wait_for_registrations(1) );
+			}
+
+			THEN("the losing attempts are cancelled quietly, and the race is over") {
+				REQUIRE( handle_events_until(irc, [&]{ return connects == 1; }) );
+				handle_events_for(std::chrono::milliseconds(600));
+				REQUIRE( errors == 0 );
+				REQUIRE( connects == 1 );
+				REQUIRE( connection.current_state() == slirc::apis::connection::state::connected );
+				REQUIRE( server.registrations == 1 );
+			}
+
+			connection.disconnect();
+		}
+
+		WHEN("connecting again while a race is running") {
+			connection.connect("irc://eyeballs.invalid", server.port());
+			handle_events_for(std::chrono::milliseconds(100));
+
+			// hold up the network service, so that the cancelled attempt of
+			// the stale race completes while the new race is running
+			std::promise<void> hold;
+			std::shared_future<void> held(hold.get_future());
+			slirc::network::service().post([held]{ held.wait(); });
+			connection.disconnect();
+			const auto restarted = clock::now();
+			connection.connect("irc://eyeballs.invalid", server.port());
+			hold.set_value();
+
+			THEN("the attempts and delays of the stale race are ignored") {
+				REQUIRE( handle_events_until(irc, [&]{ return connects == 1; }) );
+				REQUIRE( std::chrono::milliseconds(250) <= connected_at - restarted );
+				handle_events_for(std::chrono::milliseconds(600));
+				REQUIRE( errors == 0 );
+				REQUIRE( connects == 1 );
+				REQUIRE( server.registrations == 1 );
+			}
+
+			connection.disconnect();
+		}
+	}
+}
+
+SCENARIO("modules::connection - traffic statistics", "") {
+	GIVEN("a connection to a server stand-in") {
+		slirc::test::irc_server server;
+
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+		connection.set_registration("NICK tester\r\nUSER tester 0 * :Tester\r\n");
+
+		std::vector<std::string> lines;
+		irc.event_manager().connect(slirc::apis::connection::received_line, [&](slirc::event::pointer e){
+			lines.push_back(e->components.at<slirc::apis::connection::received_data>().data());
+		});
+
+		connection.connect("irc://127.0.0.1", server.port());
+		REQUIRE( server.wait_for_registrations(1) );
+		REQUIRE( handle_events_until(irc, [&]{ return !lines.empty(); }) );
+
+		THEN("the connection is up, and everything queued has been sent") {
+			const auto traffic = connection.get_traffic_stats();
+			REQUIRE( std::chrono::steady_clock::duration::zero() < traffic.connected_for );
+			REQUIRE( traffic.reconnects == 0 );
+			REQUIRE( handle_events_until(irc, [&]{ return connection.get_traffic_stats().send_queued == 0; }) );
+			REQUIRE( connection.get_traffic_stats().bytes_out == std::string("NICK tester\r\nUSER tester 0 * :Tester\r\n").size() );
+		}
+
+		THEN("the statistics of the first connection match the traffic counters") {
+			const auto traffic = connection.get_traffic_stats();
+			const auto stats = connection.get_statistics();
+			REQUIRE( 0 < stats.reads );
+			REQUIRE( stats.reads == traffic.reads );
+			REQUIRE( stats.bytes_in == traffic.bytes_in );
+		}
+
+		WHEN("the server sends part of a line") {
+			const std::string partial = ":stand-in NOTICE tester :part";
+			server.send(partial);
+
+			THEN("it is buffered until the rest arrives") {
+				REQUIRE( handle_events_until(irc, [&]{ return connection.get_traffic_stats().receive_buffered == partial.size(); }) );
+				server.send("ial\r\n");
+				REQUIRE( handle_events_until(irc, [&]{ return lines.size() == 2; }) );
+				REQUIRE( lines.back() == partial + "ial" );
+				REQUIRE( connection.get_traffic_stats().receive_buffered == 0 );
+			}
+		}
+
+		WHEN("sending a PING") {
+			REQUIRE( connection.get_traffic_stats().ping_rtt == std::chrono::steady_clock::duration::zero() );
+			connection.send_raw("PING :rtt\r\n");
+
+			THEN("the round trip to its PONG is measured") {
+				REQUIRE( handle_events_until(irc, [&]{ return lines.size() == 2; }) );
+				REQUIRE( lines.back() == ":stand-in PONG stand-in :rtt" );
+				REQUIRE( std::chrono::steady_clock::duration::zero() < connection.get_traffic_stats().ping_rtt );
+			}
+		}
+
+		connection.disconnect();
+	}
+
+	GIVEN("a connection to a server dropping it after the welcome") {
+		dropping_listener server(true);
+
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+		connection.set_reconnect_policy({ true, std::chrono::milliseconds(1), std::chrono::milliseconds(1), 1.0, 0.0 });
+		connection.connect("irc://127.0.0.1", server.port());
+
+		THEN("reconnects are counted, and the statistics cover the last connection only") {
+			REQUIRE( handle_events_until(irc, [&]{ return connection.get_traffic_stats().reconnects >= 2; }) );
+			REQUIRE( connection.get_statistics().bytes_in < connection.get_traffic_stats().bytes_in );
+		}
+
+		connection.disconnect();
+	}
+}
@@ -0,0 +1,274 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#include "testcase.hpp"
+#include "event_loop.hpp"
+#include "../bench/tls_server.hpp"
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../include/slirc/irc.hpp"
+#include "../include/slirc/network.hpp"
+#include "../include/slirc/apis/event_manager.hpp"
+#include "../include/slirc/modules/connection.hpp"
+
+#include "../src/event.cpp"
+#include "../src/irc.cpp"
+#include "../src/network.cpp"
+#include "../src/modules/connection.cpp"
+#include "../src/modules/event_manager.cpp"
+#include "../src/util/line_scanner.cpp"
+
+// The TLS parts of modules::connection, against the TLS server stand-in of
+// the benchmarks. Unlike the other tests, this needs to be built with SSL.
+
+namespace {
+	using slirc::test::handle_events_until;
+
+	// connects and waits for the stand-in's greeting, by which time session
+	// tickets sent after the handshake have been read
+	bool connect_and_greet(slirc::irc &irc, slirc::modules::connection &connection, unsigned short port) {
+		unsigned long long greeted = 0;
+		auto greeting = irc.event_manager().connect(slirc::apis::connection::received_line, [&](slirc::event::pointer){
+			++greeted;
+		});
+		connection.connect("ssl://127.0.0.1", port);
+		const bool ok = handle_events_until(irc, [&]{ return greeted != 0; });
+		greeting.disconnect();
+		return ok;
+	}
+
+#ifdef SLIRC_HAVE_KTLS
+	// HKDF-Expand-Label with SHA-256, as used to set up kTLS, in hex
+	std::string expand_label_hex(const std::string &secret_hex, const std::string &label, std::size_t length) {
+		traffic_secret secret;
+		secret.size = secret_hex.size() / 2;
+		for(std::size_t i=0; i<secret.size; ++i) {
+			secret.bytes[i] = static_cast<unsigned char>(std::stoul(secret_hex.substr(2*i, 2), nullptr, 16));
+		}
+
+		std::vector<unsigned char> out(length);
+		if (!expand_label(EVP_sha256(), secret, label, out.data(), out.size())) {
+			return "(failed)";
+		}
+
+		std::string result;
+		for(unsigned char byte : out) {
+			result += "0123456789abcdef"[byte >> 4];
+			result += "0123456789abcdef"[byte & 0xf];
+		}
+		return result;
+	}
+#endif
+
+	bool disconnect_and_wait(slirc::irc &irc, slirc::modules::connection &connection) {
+		connection.disconnect();
+		return handle_events_until(irc, [&]{
+			return connection.current_state() == slirc::apis::connection::state::disconnected;
+		});
+	}
+}
+
+SCENARIO("modules::connection - failing TLS handshakes", "") {
+	GIVEN("a TLS server stand-in rejecting handshakes") {
+		slirc::bench::tls_server server;
+		server.reject_handshakes = true;
+
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+		connection.set_reconnect_policy({ true, std::chrono::milliseconds(1), std::chrono::milliseconds(1), 1.0, 0.0 });
+
+		unsigned errors = 0;
+		irc.event_manager().connect(slirc::modules::connection::error, [&](slirc::event::pointer){
+			++errors;
+		});
+
+		WHEN("connecting") {
+			connection.connect("ssl://127.0.0.1", server.port());
+
+			THEN("the connection reports each failure and tries again") {
+				REQUIRE( handle_events_until(irc, [&]{ return 3 <= server.accepted && 2 <= errors; }) );
+				REQUIRE( connection.current_state() != slirc::apis::connection::state::connected );
+			}
+
+			connection.disconnect();
+		}
+	}
+}
+
+SCENARIO("modules::connection - resuming TLS sessions", "") {
+	GIVEN("a connection to a TLS server stand-in that has been connected before") {
+		slirc::bench::tls_server server;
+
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+
+		unsigned errors = 0;
+		irc.event_manager().connect(slirc::modules::connection::error, [&](slirc::event::pointer){
+			++errors;
+		});
+
+		REQUIRE( connect_and_greet(irc, connection, server.port()) );
+		REQUIRE_FALSE( connection.get_statistics().last_handshake_resumed );
+		REQUIRE( disconnect_and_wait(irc, connection) );
+
+		WHEN("reconnecting") {
+			REQUIRE( connect_and_greet(irc, connection, server.port()) );
+
+			THEN("the session is resumed") {
+				REQUIRE( connection.get_statistics().last_handshake_resumed );
+				REQUIRE( server.resumed == 1 );
+			}
+
+			REQUIRE( disconnect_and_wait(irc, connection) );
+		}
+
+		WHEN("a handshake offering the session fails") {
+			server.reject_handshakes = true;
+			connection.connect("ssl://127.0.0.1", server.port());
+			REQUIRE( handle_events_until(irc, [&]{ return errors == 1; }) );
+			REQUIRE( handle_events_until(irc, [&]{
+				return connection.current_state() == slirc::apis::connection::state::disconnected;
+			}) );
+
+			THEN("the session is dropped, and the next handshake is a full one") {
+				REQUIRE_FALSE( tls_session_cache::instance().find("127.0.0.1:" + std::to_string(server.port())) );
+				server.reject_handshakes = false;
+				REQUIRE( connect_and_greet(irc, connection, server.port()) );
+				REQUIRE_FALSE( connection.get_statistics().last_handshake_resumed );
+				REQUIRE( server.resumed == 0 );
+				REQUIRE( disconnect_and_wait(irc, connection) );
+			}
+		}
+	}
+}
+
+SCENARIO("modules::connection - sharing a TLS context", "") {
+	GIVEN("two connections") {
+		slirc::bench::tls_server server;
+
+		slirc::irc irc_a, irc_b;
+		auto &a = irc_a.load<slirc::modules::connection>();
+		auto &b = irc_b.load<slirc::modules::connection>();
+
+		THEN("both use the default context") {
+			REQUIRE( a.get_tls_context() );
+			REQUIRE( a.get_tls_context() == slirc::modules::connection::default_tls_context() );
+			REQUIRE( b.get_tls_context() == a.get_tls_context() );
+		}
+
+		WHEN("both are set to another context and connect, and one reconnects a few times") {
+			auto context = std::make_shared<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23_client);
+			a.set_tls_context(context);
+			b.set_tls_context(context);
+			SSL_CTX *default_native = slirc::modules::connection::default_tls_context()->native_handle();
+			const long default_handshakes = SSL_CTX_sess_connect_good(default_native);
+
+			REQUIRE( connect_and_greet(irc_a, a, server.port()) );
+			REQUIRE( connect_and_greet(irc_b, b, server.port()) );
+			for(int i=0; i<3; ++i) {
+				REQUIRE( disconnect_and_wait(irc_a, a) );
+				REQUIRE( connect_and_greet(irc_a, a, server.port()) );
+			}
+
+			THEN("every handshake uses that context, each on a fresh stream") {
+				REQUIRE( a.get_tls_context() == context );
+				REQUIRE( SSL_CTX_sess_connect_good(context->native_handle()) == 5 );
+				REQUIRE( SSL_CTX_sess_connect_good(default_native) == default_handshakes );
+				REQUIRE( server.handshakes == 5 );
+			}
+
+			REQUIRE( disconnect_and_wait(irc_a, a) );
+			REQUIRE( disconnect_and_wait(irc_b, b) );
+		}
+	}
+}
+
+SCENARIO("modules::connection - TLS handshakes on a handshake pool", "") {
+	GIVEN("a handshake pool of one thread and a TLS server stand-in echoing lines") {
+		slirc::network::set_handshake_threads(1);
+		slirc::bench::tls_server server(true);
+
+		slirc::irc irc;
+		auto &connection = irc.load<slirc::modules::connection>();
+
+		std::vector<std::string> lines;
+		irc.event_manager().connect(slirc::apis::connection::received_line, [&](slirc::event::pointer e){
+			lines.push_back(e->components.at<slirc::apis::connection::received_data>().data());
+		});
+
+		WHEN("connecting") {
+			connection.connect("ssl://127.0.0.1", server.port());
+
+			THEN("the handshake completes, and the connection leaves the pool behind") {
+				REQUIRE( handle_events_until(irc, [&]{ return lines.size() == 1; }) );
+				REQUIRE( connection.get_statistics().tls_handshakes == 1 );
+
+				// retiring the pool lets its thread end only if nothing of
+				// the connection keeps it busy
+				slirc::network::set_handshake_threads(0);
+				const auto retired_pool_stopped = [&]{
+					std::unique_lock<std::mutex> lock(handshake_pool.mutex);
+					return handshake_pool.retired.back()->service.stopped();
+				};
+				REQUIRE( handle_events_until(irc, retired_pool_stopped) );
+
+				// so reads and writes complete on the network service
+				connection.send_raw("PRIVMSG #test :echo\r\n");
+				REQUIRE( handle_events_until(irc, [&]{ return lines.size() == 2; }) );
+				REQUIRE( lines.back() == "PRIVMSG #test :echo" );
+			}
+
+			connection.disconnect();
+		}
+
+		slirc::network::set_handshake_threads(0);
+	}
+}
+
+#ifdef SLIRC_HAVE_KTLS
+SCENARIO("modules::connection - deriving the keys for kTLS", "") {
+	GIVEN("the traffic secrets of the TLS 1.3 handshake in RFC 8448, section 3") {
+		THEN("the client's application write key and IV match the RFC") {
+			const std::string secret = "9e40646ce79a7f9dc05af8889bce6552875afa0b06df0087f792ebb7c17504a5";
+			REQUIRE( expand_label_hex(secret, "key", 16) == "17422dda596ed5d9acd890e3c63f5051" );
+			REQUIRE( expand_label_hex(secret, "iv", 12) == "5b78923dee08579033e523d9" );
+		}
+
+		THEN("the client's handshake write key and IV match the RFC") {
+			const std::string secret = "b3eddb126e067f35a780b3abf45e2d8f3b1a950738f52e9600746a0e27a55a21";
+			REQUIRE( expand_label_hex(secret, "key", 16) == "dbfaa693d1762c5b666af5d950258d01" );
+			REQUIRE( expand_label_hex(secret, "iv", 12) == "5bd3c71b836e0b76bb73265f" );
+		}
+
+		THEN("the server's application write key and IV match the RFC") {
+			const std::string secret = "a11af9f05531f856ad47116b45a950328204b4f44bfb6b3a4b4f1f3fcb631643";
+			REQUIRE( expand_label_hex(secret, "key", 16) == "9f02283b6c9c07efc26bb9f2ac92e356" );
+			REQUIRE( expand_label_hex(secret, "iv", 12) == "cf782b88dd83549aadf1e984" );
+		}
+	}
+}
+#endif
@@ -0,0 +1,184 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#include "testcase.hpp"
+
+#include <string>
+#include <vector>
+
+#include "../include/slirc/util/line_scanner.hpp"
+
+#include "../src/util/line_scanner.cpp"
+
+namespace {
+	typedef std::vector<slirc::util::detail::index_lines_implementation> implementations;
+
+	std::vector<std::string> split(
+		const slirc::util::detail::index_lines_implementation &implementation,
+		const std::string &data, std::size_t &consumed, std::size_t scan_from = 0
+	) {
+		std::vector<slirc::util::line_span> spans;
+		consumed = implementation.function(data.data(), data.size(), spans, scan_from);
+
+		std::vector<std::string> lines;
+		for(const auto &span : spans) {
+			lines.push_back(data.substr(span.begin, span.length));
+		}
+		return lines;
+	}
+}
+
+SCENARIO("util - line scanner", "") {
+	const implementations all = slirc::util::detail::supported_index_lines_implementations();
+
+	GIVEN("a buffer without line breaks") {
+		const std::string data(100, 'x');
+
+		WHEN("indexing its lines") {
+			THEN("no lines are found") {
+				for(const auto &implementation : all) {
+					INFO( implementation.name );
+					std::size_t consumed;
+					REQUIRE( split(implementation, data, consumed).empty() );
+					REQUIRE( consumed == 0 );
+				}
+			}
+		}
+	}
+
+	GIVEN("a buffer with mixed line endings and a partial line") {
+		const std::string data = "PING :a\r\nPING :b\n\r\n\nPING :c";
+
+		WHEN("indexing its lines") {
+			THEN("the complete lines are found without their line breaks, the partial line is not consumed") {
+				for(const auto &implementation : all) {
+					INFO( implementation.name );
+					std::size_t consumed;
+					REQUIRE( split(implementation, data, consumed) == std::vector<std::string>({ "PING :a", "PING :b", "", "" }) );
+					REQUIRE( data.substr(consumed) == "PING :c" );
+				}
+			}
+		}
+
+		WHEN("starting the search after the first line break") {
+			THEN("the first line is merged into the second one") {
+				for(const auto &implementation : all) {
+					INFO( implementation.name );
+					std::size_t consumed;
+					const auto lines = split(implementation, data, consumed, 9);
+					REQUIRE( lines.front() == "PING :a\r\nPING :b" );
+					REQUIRE( lines.size() == 3 );
+				}
+			}
+		}
+	}
+
+	GIVEN("a buffer with line breaks at every position of a vector register") {
+		// lines of lengths 0 to 69, so line breaks hit every lane of 16 and
+		// 32 byte wide chunks, some of them preceded by a carriage return
+		std::string data;
+		std::vector<std::string> expected;
+		for(std::size_t length = 0; length < 70; ++length) {
+			expected.push_back(std::string(length, 'a' + length % 26));
+			data += expected.back();
+			data += (length % 3) ? "\n" : "\r\n";
+		}
+		data += "tail";
+
+		WHEN("indexing its lines") {
+			THEN("all lines are found") {
+				for(const auto &implementation : all) {
+					INFO( implementation.name );
+					std::size_t consumed;
+					REQUIRE( split(implementation, data, consumed) == expected );
+					REQUIRE( data.substr(consumed) == "tail" );
+				}
+			}
+		}
+	}
+
+	GIVEN("line breaks at the 16 and 32 byte boundaries") {
+		THEN("they are found on either side of each boundary, with and without a carriage return") {
+			for(const std::size_t boundary : { 16, 32, 64 }) {
+				for(const std::size_t position : { boundary - 2, boundary - 1, boundary, boundary + 1 }) {
+					for(const bool cr : { false, true }) {
+						// the terminator ends at position, so a "\r\n" at
+						// boundary - 1 straddles the boundary
+						const std::size_t length = position - (cr ? 1 : 0);
+						const std::string line(length, 'x');
+						const std::string data = line + (cr ? "\r\n" : "\n") + std::string(40, 'y');
+
+						for(const auto &implementation : all) {
+							INFO( implementation.name << ": line break at " << position << (cr ? " after a carriage return" : "") );
+							std::size_t consumed;
+							REQUIRE( split(implementation, data, consumed) == std::vector<std::string>({ line }) );
+							REQUIRE( consumed == position + 1 );
+						}
+					}
+				}
+			}
+		}
+
+		THEN("they are found when the search starts directly in front of them") {
+			for(const std::size_t position : { 15, 16, 31, 32 }) {
+				const std::string data = std::string(position, 'x') + "\n" + std::string(40, 'y');
+
+				for(const auto &implementation : all) {
+					INFO( implementation.name << ": line break at " << position );
+					std::size_t consumed;
+					REQUIRE( split(implementation, data, consumed, position).size() == 1 );
+					REQUIRE( consumed == position + 1 );
+				}
+			}
+		}
+
+		THEN("a buffer ending exactly at a boundary is scanned completely") {
+			for(const std::size_t size : { 16, 32, 64 }) {
+				const std::string data = std::string(size - 1, 'x') + "\n";
+
+				for(const auto &implementation : all) {
+					INFO( implementation.name << ": buffer of " << size << " bytes" );
+					std::size_t consumed;
+					REQUIRE( split(implementation, data, consumed).size() == 1 );
+					REQUIRE( consumed == size );
+				}
+			}
+		}
+	}
+
+	GIVEN("the implementation in use") {
+		const std::string name = slirc::util::index_lines_implementation();
+
+		THEN("it is the fastest supported implementation") {
+			REQUIRE( name == all.back().name );
+			REQUIRE( (name == "avx2" || name == "sse2" || name == "scalar") );
+		}
+
+		THEN("it is used by index_lines()") {
+			const std::string data = "PING :a\r\nPING :b";
+			std::vector<slirc::util::line_span> spans;
+			REQUIRE( slirc::util::index_lines(data.data(), data.size(), spans) == 9 );
+			REQUIRE( spans.size() == 1 );
+			REQUIRE( spans.front().length == 7 );
+		}
+	}
+}
@@ -0,0 +1,97 @@
+/***************************************************************************
+**  Copyright 2016-2016 by Simon "SlashLife" Stienen                      **
+**  http://projects.slashlife.org/libslirc/                               **
+**  libslirc@projects.slashlife.org                                       **
+**                                                                        **
+**  This file is part of libslIRC.                                        **
+**                                                                        **
+**  libslIRC is free software: you can redistribute it and/or modify      **
+**  it under the terms of the GNU Lesser General Public License as        **
+**  published by the Free Software Foundation, either version 3 of the    **
+**  License, or (at your option) any later version.                       **
+**                                                                        **
+**  libslIRC is distributed in the hope that it will be useful,           **
+**  but WITHOUT ANY WARRANTY; without even the implied warranty of        **
+**  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         **
+**  GNU General Public License for more details.                          **
+**                                                                        **
+**  You should have received a copy of the GNU General Public License     **
+**  and the GNU Lesser General Public License along with libslIRC.        **
+**  If not, see <http://www.gnu.org/licenses/>.                           **
+***************************************************************************/
+
+#include "testcase.hpp"
+
+#include <thread>
+#include <vector>
+
+#include "../include/slirc/util/mpsc_queue.hpp"
+
+SCENARIO("util - mpsc queue", "") {
+	GIVEN("an empty queue") {
+		slirc::util::mpsc_queue<int> queue;
+
+		THEN("it is empty") {
+			REQUIRE( queue.empty() );
+			REQUIRE( queue.consume_all([](int){}) == 0 );
+		}
+
+		WHEN("pushing elements") {
+			queue.push(1);
+			queue.push(2);
+			queue.push(3);
+
+			THEN("it is not empty") {
+				REQUIRE( !queue.empty() );
+			}
+
+			THEN("consuming them yields all elements in the order pushed") {
+				std::vector<int> consumed;
+				REQUIRE( queue.consume_all([&](int value){ consumed.push_back(value); }) == 3 );
+				REQUIRE( consumed == std::vector<int>({ 1, 2, 3 }) );
+				REQUIRE( queue.empty() );
+			}
+
+			THEN("a throwing consumer drops the remaining elements") {
+				int calls = 0;
+				REQUIRE_THROWS( queue.consume_all([&](int){ ++calls; throw 0; }) );
+				REQUIRE( calls == 1 );
+				REQUIRE( queue.empty() );
+			}
+		}
+
+		WHEN("pushing from multiple threads while consuming") {
+			constexpr int threads = 4;
+			constexpr int per_thread = 10000;
+
+			std::vector<std::thread> producers;
+			for(int t=0; t<threads; ++t) {
+				producers.emplace_back([&queue, t]{
+					for(int i=0; i<per_thread; ++i) {
+						queue.push(t * per_thread + i);
+					}
+				});
+			}
+
+			std::vector<int> next(threads, 0);
+			int total = 0;
+			bool ordered = true;
+			while(total < threads * per_thread) {
+				total += queue.consume_all([&](int value) {
+					int &expected = next[value / per_thread];
+					ordered = ordered && (value % per_thread == expected);
+					++expected;
+				});
+			}
+			for(auto &producer : producers) {
+				producer.join();
+			}
+
+			THEN("all elements are consumed in the order each thread pushed them") {
+				REQUIRE( total == threads * per_thread );
+				REQUIRE( ordered );
+				REQUIRE( queue.empty() );
+			}
+		}
+	}
+}